@@ -1,6 +1,9 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <list>
+#include <atomic>
+#include <mutex>
 #include <memory>
 #include <iostream>
 
@@ -13,17 +16,40 @@
 #include "timer.hpp"
 #include "asyncmodel.hpp"
 #include "resource.hpp"
+#include "render_upload.hpp"
+#include "vertex_layout.hpp"
 #include "shader.hpp"
+#include "render_list.hpp"
+#include "render_cull.hpp"
+#include "spatial_tree.hpp"
+#include "mesh.hpp"
 #include "object.hpp"
 #include "game.hpp"
 
+// unlinked resources evicted per tick while over the resource memory budget
+const UInt32 RESOURCE_EVICTIONS_PER_TICK = 4;
+// per frame budget for finalizing streamed resources on the main thread
+const double RESOURCE_FINALIZE_SECONDS = 0.002;
+const UInt RESOURCE_FINALIZE_BYTES = 4*1024*1024;
+// seconds a changed resource file must stay untouched before it is reloaded, 0 disables hot reload
+const double RESOURCE_HOT_RELOAD_DEBOUNCE = 0.1;
+
 //////////////////////////////////////////////////////////////////////////
 class GameSystemImplementation {
 public:
     Int32 width, height;
     ResourceManager resMan;
+    ResourceHandleTyped<ResourceShader>::type vertShaderRes, fragShaderRes; // kept linked so edits reload them in place
+    ResourceHandleTyped<ResourceMesh>::type meshRes;
+    RenderUploadQueue uploads; // declared before the batchers so it outlives them
     RenderBatcher batch;
+    RenderDrawList drawList;
     Shader shader;
+    ShaderUniform projectionUniform, modelviewUniform, camxUniform, camyUniform;
+    glm::mat4 projection, modelview; // kept for building the culling frustum
+    SpatialTree scene;
+    UInt32 meshObject;
+    std::vector<UInt32> visible;
     float pcamx, pcamy, pcamz;
     float camx, camy, camz;
 
@@ -32,12 +58,19 @@ public:
 
     void Update(GameSystem &game, const std::shared_ptr<Controller> &inController);
     void Draw(GameSystem &game);
+    void ReloadShader();
+    void ResolveUniforms();
+    void UploadMesh();
+
+    static void OnResourceReloaded(void *inUserData, const std::string &inLocation, const ResourceHandle &inResource);
 
     void SetPerspective(Int32 width, Int32 height) {
-        shader["projection"] = glm::perspective(60.0f, float(width)/float(height), 0.1f, 100.0f);
+        projection = glm::perspective(60.0f, float(width)/float(height), 0.1f, 100.0f);
+        shader[projectionUniform] = projection;
     }
     void LookAt(const glm::vec3 &eye, const glm::vec3 &target, const glm::vec3 &up) {
-        shader["modelview"] = glm::lookAt(eye, target, up);
+        modelview = glm::lookAt(eye, target, up);
+        shader[modelviewUniform] = modelview;
     }
 };
 
@@ -81,76 +114,91 @@ Int32 GameSystem::GetHeight() const {
 }
 
 //////////////////////////////////////////////////////////////////////////
-GameSystemImplementation::GameSystemImplementation(Int32 inWidth, Int32 inHeight) : width(inWidth), height(inHeight), camx(0), camy(0), camz(6.0f) {
+GameSystemImplementation::GameSystemImplementation(Int32 inWidth, Int32 inHeight) : width(inWidth), height(inHeight), meshObject(0), camx(0), camy(0), camz(6.0f) {
     resMan.AddResourceLoader<ResourceShader>("glf");
     resMan.AddResourceLoader<ResourceShader>("glv");
+    resMan.AddResourceLoader<ResourceMesh>("msh");
+#ifndef POLYMANIA_EMBEDDED_RESOURCES
+    // embedded builds read the copies compiled into the binary, edits on disk would never show
+    resMan.SetHotReload(RESOURCE_HOT_RELOAD_DEBOUNCE);
+#endif
+    resMan.Subscribe(&OnResourceReloaded, this);
 
     Shader::SetBlendFunc(Shader::BLEND_Transparent);
 
-    std::string vertshader = resMan.Load<ResourceShader>("shaders/default.glv")->string;
-    std::string fragshader = resMan.Load<ResourceShader>("shaders/default.glf")->string;
-    shader.Initialize(vertshader, fragshader, true);
+    // load both stages in parallel, the Loads below then just find them resident
+    std::vector<std::string> shaderLocations;
+    shaderLocations.push_back("shaders/default.glv");
+    shaderLocations.push_back("shaders/default.glf");
+    std::vector<ResourceHandle> shaderResources;
+    resMan.LoadMany(shaderLocations, shaderResources);
+
+    vertShaderRes = resMan.Load<ResourceShader>(shaderLocations[0]);
+    fragShaderRes = resMan.Load<ResourceShader>(shaderLocations[1]);
+    shader.Initialize(vertShaderRes->GetString(), fragShaderRes->GetString(), true);
+    ResolveUniforms();
     SetPerspective(width, height);
     LookAt(glm::vec3(0.0f, 0.0f, camz), glm::vec3(camx, camy, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
     batch.SetShader(shader);
 
-    Vertex verts[] = {
-        // front
-        {0.0f,  0.0f, 1.0f, 255, 0, 0, 255},
-        {-1.0f,  0.0f, 1.0f, 0, 0, 255, 150},
-        {-1.0f, -1.0f, 1.0f, 0, 255, 0, 0},
-        {0.0f,  0.0f, 1.0f, 255, 0, 0, 255},
-        {-1.0f,  -1.0f, 1.0f, 0, 255, 0, 0},
-        {0.0f, -1.0f, 1.0f, 0, 0, 255, 150},
-
-        // back
-        {0.0f,  -1.0f, 0.0f, 255, 0, 0, 255},
-        {-1.0f, -1.0f, 0.0f, 0, 0, 255, 150},
-        {-1.0f,  0.0f, 0.0f, 0, 255, 0, 0},
-        {0.0f,  -1.0f, 0.0f, 255, 0, 0, 255},
-        {-1.0f,  0.0f, 0.0f, 0, 255, 0, 0},
-        {0.0f,   0.0f, 0.0f, 0, 0, 255, 150},
-
-        // top
-        {0.0f,  0.0f, 0.0f, 255, 0, 0, 255},
-        {-1.0f,  0.0f, 0.0f, 0, 0, 255, 150},
-        {-1.0f,  0.0f, 1.0f, 0, 255, 0, 0},
-        {0.0f,  0.0f, 0.0f, 255, 0, 0, 255},
-        {-1.0f,  0.0f, 1.0f, 0, 255, 0, 0},
-        {0.0f,  0.0f, 1.0f, 0, 0, 255, 150},
-
-        // bottom
-        {0.0f,  -1.0f, 1.0f, 255, 0, 0, 255},
-        {-1.0f, -1.0f, 1.0f, 0, 0, 255, 150},
-        {-1.0f, -1.0f, 0.0f, 0, 255, 0, 0},
-        {0.0f,  -1.0f, 1.0f, 255, 0, 0, 255},
-        {-1.0f, -1.0f, 0.0f, 0, 255, 0, 0},
-        {0.0f,  -1.0f, 0.0f, 0, 0, 255, 150},
-
-        // left
-        {-1.0f,  0.0f, 1.0f, 255, 0, 0, 255},
-        {-1.0f,  0.0f, 0.0f, 0, 0, 255, 150},
-        {-1.0f, -1.0f, 0.0f, 0, 255, 0, 0},
-        {-1.0f,  0.0f, 1.0f, 255, 0, 0, 255},
-        {-1.0f, -1.0f, 0.0f, 0, 255, 0, 0},
-        {-1.0f, -1.0f, 1.0f, 0, 0, 255, 150},
-
-        // right
-        {0.0f,  0.0f, 0.0f, 255, 0, 0, 255},
-        {0.0f,  0.0f, 1.0f, 0, 0, 255, 150},
-        {0.0f, -1.0f, 1.0f, 0, 255, 0, 0},
-        {0.0f,  0.0f, 0.0f, 255, 0, 0, 255},
-        {0.0f, -1.0f, 1.0f, 0, 255, 0, 0},
-        {0.0f, -1.0f, 0.0f, 0, 0, 255, 150}
-    };
-    batch.Queue(verts, sizeof(verts)/sizeof(Vertex));
-    batch.Upload(RenderBatcher::USAGE_Static);
+    meshRes = resMan.Load<ResourceMesh>("meshes/cube.msh");
+    UploadMesh();
 }
 
 GameSystemImplementation::~GameSystemImplementation() {
 }
 
+void GameSystemImplementation::OnResourceReloaded(void *inUserData, const std::string &inLocation, const ResourceHandle &inResource) {
+    GameSystemImplementation *self = (GameSystemImplementation*)inUserData;
+    if(inResource && (inResource == self->vertShaderRes || inResource == self->fragShaderRes)) {
+        self->ReloadShader();
+    } else if(inResource && inResource == self->meshRes) {
+        self->UploadMesh();
+    }
+}
+
+void GameSystemImplementation::UploadMesh() {
+    if(!meshRes) {
+        std::cerr << "Failed to load mesh" << std::endl;
+        return;
+    }
+    // straight from the file data, the handle keeps it alive until it is on the GPU
+    batch.Upload(uploads, meshRes->vertices, meshRes->numVertices, meshRes, RenderBatcher::USAGE_Static);
+    if(meshRes->indices) batch.UploadIndices(meshRes->indices, meshRes->numIndices, meshRes->indexSize, RenderBatcher::USAGE_Static);
+    else batch.ClearIndices();
+
+    if(scene.GetNumObjects()) {
+        scene.Update(meshObject, meshRes->boundsMin, meshRes->boundsMax);
+        scene.Refit();
+    } else {
+        meshObject = scene.Insert(meshRes->boundsMin, meshRes->boundsMax);
+        scene.Build();
+    }
+}
+
+void GameSystemImplementation::ReloadShader() {
+    // a shader with errors keeps the previous program running
+    if(!shader.Initialize(vertShaderRes->GetString(), fragShaderRes->GetString(), true)) return;
+
+    // uniforms and attribute locations do not survive relinking
+    ResolveUniforms();
+    SetPerspective(width, height);
+    LookAt(glm::vec3(camx, camy, camz), glm::vec3(camx, camy, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    shader[camxUniform] = camx;
+    shader[camyUniform] = camy;
+    batch.SetShader(shader);
+}
+
+void GameSystemImplementation::ResolveUniforms() {
+    projectionUniform = shader.GetUniform("projection");
+    modelviewUniform = shader.GetUniform("modelview");
+    camxUniform = shader.GetUniform("camx");
+    camyUniform = shader.GetUniform("camy");
+}
+
 void GameSystemImplementation::Update(GameSystem &game, const std::shared_ptr<Controller> &k) {
+    resMan.Trim(RESOURCE_EVICTIONS_PER_TICK);
+
     pcamx = camx; 
     pcamy = camy; 
     pcamz = camz;
@@ -162,15 +210,22 @@ void GameSystemImplementation::Update(GameSystem &game, const std::shared_ptr<Co
     if(k->y) camz += 0.1f;
 }
 void GameSystemImplementation::Draw(GameSystem &game){
+    resMan.Update(RESOURCE_FINALIZE_SECONDS, RESOURCE_FINALIZE_BYTES);
+    uploads.Update();
+
     if(pcamx != camx || pcamy != camy || pcamz != camz) {
         float icamx = pcamx+(camx-pcamx)*float(game.interp);
         float icamy = pcamy+(camy-pcamy)*float(game.interp);
         float icamz = pcamz+(camz-pcamz)*float(game.interp);
         LookAt(glm::vec3(icamx, icamy, icamz), glm::vec3(icamx, icamy, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        shader["camx"] = icamx;
-        shader["camy"] = icamy;
+        shader[camxUniform] = icamx;
+        shader[camyUniform] = icamy;
     }
-    batch.Draw();
+
+    visible.clear();
+    scene.Cull(RenderFrustum(projection*modelview), visible);
+    if(!visible.empty()) batch.Submit(drawList, 0, 0.0f, Shader::BLEND_Transparent);
+    drawList.Execute();
 }
 
 
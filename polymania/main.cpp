@@ -17,7 +17,12 @@
 #include <cstdint>
 #include <cstddef>
 #include <unordered_map>
+#include <list>
+#include <atomic>
+#include <mutex>
 #include <iostream>
+#include <chrono>
+#include <thread>
 #include <type_traits>
 #include <limits>
 #include <memory>
@@ -39,7 +44,14 @@
 #include "timer.hpp"
 #include "asyncmodel.hpp"
 #include "resource.hpp"
+#include "resource_tracking.hpp"
+#include "resource_prefetch.hpp"
+#include "resource_dedup.hpp"
+#include "resource_embedded.hpp"
+#include "vertex_layout.hpp"
 #include "shader.hpp"
+#include "render_state.hpp"
+#include "render_vao.hpp"
 #include "object.hpp"
 #include "game.hpp"
 #include "globals.hpp"
@@ -61,6 +73,11 @@ const int HEIGHT = 600;
 const bool DEFAULT_VSYNC_ON = false;
 const UInt32 TICK_PER_SEC = 20;
 const double SEC_PER_TICK = 1.0/TICK_PER_SEC;
+const double MEMORY_STATS_INTERVAL = 30.0; // seconds between resource memory dumps, 0 disables them
+// files touched during the first seconds of a run are prefetched at the start of the next one
+const char *RESOURCE_TRACE_LOCATION = "resources.trace";
+const double RESOURCE_TRACE_SECONDS = 30.0;
+const UInt32 RESOURCE_PREFETCH_THREADS = 4;
 
 // Real Globals
 GameSystem *GGameSys=0;
@@ -68,22 +85,6 @@ GameSystem *GGameSys=0;
 ///////////////////////////////////////////////////////////
 // Utils
 
-struct AutoVao {
-    UInt32 vaoID;
-    AutoVao() {
-#ifndef __arm__
-        glGenVertexArrays(1, &vaoID);
-        glBindVertexArray(vaoID);
-#endif
-    }
-    ~AutoVao() {
-#ifndef __arm__
-        glBindVertexArray(0);
-        glDeleteVertexArrays(1, &vaoID);
-#endif
-    }
-};
-
 inline bool FloatEquals(float a, float b, const float epsilon = std::numeric_limits<float>::epsilon()) {
     float diff = b - a;
     return (diff < epsilon) && (diff > -epsilon);
@@ -97,24 +98,25 @@ inline bool FloatInside(float a, float low, float high, const float epsilon = st
 
 static void InitGL() {
     // setup GL
-    glDisable(GL_BLEND);
+    RenderState::Invalidate();
+    RenderState::SetBlend(false);
     glDisable(GL_DITHER);     
     glDisable(GL_SCISSOR_TEST); 
     glDisable(GL_STENCIL_TEST);
 
-    glEnable(GL_DEPTH_TEST);
-    glDepthMask(GL_TRUE);
-    glDepthFunc(GL_LESS); //use GL_LEQUAL for multipass shaders
+    RenderState::SetDepthTest(true);
+    RenderState::SetDepthWrite(true);
+    RenderState::SetDepthFunc(GL_LESS); //use GL_LEQUAL for multipass shaders
     glDepthRange(0.0f, 1.0f);
     glClearDepth(1.0f);
 
-    glFrontFace(GL_CCW);
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
+    RenderState::SetFrontFace(GL_CCW);
+    RenderState::SetCulling(true);
+    RenderState::SetCullFace(GL_BACK);
     glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
 }
 
-static void EngineMain(std::shared_ptr<Context> mainWindow) {
+static void EngineMain(std::shared_ptr<Context> mainWindow, ResourceMemoryAllocatorTracking &memoryTracker) {
 #ifdef __arm__
     auto timer = std::make_shared<RaspberryPiTimer>();
     auto ctlr = std::make_shared<RaspberryPiController>();
@@ -124,12 +126,12 @@ static void EngineMain(std::shared_ptr<Context> mainWindow) {
 #endif
 
     InitGL();
-    AutoVao autoVao; // auto VAO for opengl 3+
 
     Int32 fpsFrames = 0;
     double fpsElapsed = 0.0;
     double timeFrame = 0.0;
     double timeNextTick = 0.0;
+    double timeNextMemoryStats = MEMORY_STATS_INTERVAL;
 
     auto params = Event::MakeEventData("inWidth", WIDTH)("inHeight", HEIGHT);
     GGameSys = (GameSystem*)Object::StaticConstructObject(Object::StaticFindClass("GameSystem"), params);
@@ -167,13 +169,45 @@ static void EngineMain(std::shared_ptr<Context> mainWindow) {
             fpsElapsed = 0.0;
             fpsFrames = 0;
         }
+
+        if(MEMORY_STATS_INTERVAL > 0.0 && timer->Seconds() >= timeNextMemoryStats) {
+            memoryTracker.PrintStats();
+            if(ResourceBlobStore::instance) ResourceBlobStore::instance->PrintStats();
+            timeNextMemoryStats = timer->Seconds() + MEMORY_STATS_INTERVAL;
+        }
     }
 
     Object::StaticDestroyObject(GGameSys);
     GGameSys = 0;
+    RenderVaoCache::Clear();
 }
 
 int main() {
+#ifdef POLYMANIA_EMBEDDED_RESOURCES
+    // core assets are compiled into the binary, everything else still comes from disk
+    static ResourceDirectoryEmbedded embeddedDir(ResourceEmbeddedIndex, ResourceEmbeddedCount, ResourceDirectory::instance);
+    ResourceDirectory::instance = &embeddedDir;
+#endif
+
+    // installed before anything allocates resources so every allocation is accounted for
+    ResourceMemoryAllocatorTracking memoryTracker(ResourceMemoryAllocator::instance);
+    ResourceMemoryAllocator::instance = &memoryTracker;
+
+    // start pulling in what the last run needed while the window and GL come up
+    ResourcePrefetcher prefetcher;
+    {
+        std::vector<ResourceAccessRecord> recorded;
+        if(ResourceAccessTrace::Load(RESOURCE_TRACE_LOCATION, recorded)) {
+            prefetcher.Start(*ResourceDirectory::instance, recorded, RESOURCE_PREFETCH_THREADS);
+        }
+    }
+    ResourceAccessTrace accessTrace(RESOURCE_TRACE_SECONDS);
+    ResourceDirectory::instance->SetAccessTrace(&accessTrace);
+
+    // resources with identical content share one copy, must outlive every ResourceCache
+    ResourceBlobStore blobStore;
+    ResourceBlobStore::instance = &blobStore;
+
     Object::StaticInit();
     Object* testInstance = Object::StaticConstructObject(Object::StaticFindClass("TestChild"));
     if(testInstance) testInstance->Send(Event("TestEvent"));
@@ -191,13 +225,27 @@ int main() {
 
     if(ctx->Initialize("Polymania Project", WIDTH, HEIGHT, false, DEFAULT_VSYNC_ON) < 0) {
         std::cerr << "Failed to initialize context" << std::endl;
+        ResourceDirectory::instance->SetAccessTrace(0);
+        ResourceBlobStore::instance = 0;
+        ResourceMemoryAllocator::instance = memoryTracker.GetBacking();
         return -1;
     }
 
     std::cout << "Renderer: " << (const char*)glGetString(GL_RENDERER) << std::endl;
     std::cout << "Version: " << (const char*)glGetString(GL_VERSION) << std::endl;
 
-    EngineMain(ctx);
+    EngineMain(ctx, memoryTracker);
     ctx->Terminate();
+
+    prefetcher.Stop();
+    ResourceBlobStore::instance = 0;
+    ResourceDirectory::instance->SetAccessTrace(0);
+    if(!accessTrace.Save(RESOURCE_TRACE_LOCATION)) {
+        std::cerr << "Could not save resource access trace: " << RESOURCE_TRACE_LOCATION << std::endl;
+    }
+
+    // everything loaded by the game should be gone by now, the tracker reports what is left when it goes out of scope
+    memoryTracker.PrintStats();
+    ResourceMemoryAllocator::instance = memoryTracker.GetBacking();
     return 0;
 }
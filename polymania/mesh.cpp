@@ -0,0 +1,189 @@
+#include <glm/glm.hpp>
+
+#include <cstring>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <list>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <limits>
+#include <algorithm>
+
+#include "types.hpp"
+#include "asyncmodel.hpp"
+#include "resource.hpp"
+#include "vertex_layout.hpp"
+#include "shader.hpp"
+#include "mesh_format.hpp"
+#include "mesh_codec.hpp"
+#include "mesh.hpp"
+
+// vertices are used in place, so the file data has to be at least this aligned
+static const UInt32 MESH_DATA_ALIGNMENT = 16;
+
+// checks what can be checked without the payload and returns the full file size
+static bool GetMeshFileSize(const MeshFileHeader &inHeader, UInt &outSizeBytes) {
+    if(inHeader.magic != MESH_FILE_MAGIC || inHeader.version != MESH_FILE_VERSION) return false;
+    if(inHeader.vertexSize != sizeof(Vertex)) return false;
+    if(inHeader.indexSize != 0 && inHeader.indexSize != 2 && inHeader.indexSize != 4) return false;
+    if(inHeader.indexSize == 0 && inHeader.numIndices != 0) return false;
+    if(inHeader.flags & ~MESH_FILE_FLAG_Compressed) return false;
+
+    UInt64 size = sizeof(MeshFileHeader) + UInt64(inHeader.numVertices)*inHeader.vertexSize + UInt64(inHeader.numIndices)*inHeader.indexSize;
+    if(size > std::numeric_limits<UInt>::max()) return false;
+    outSizeBytes = UInt(size);
+    return true;
+}
+
+// the index buffer is drawn as is, so an index past the vertices would read outside the vertex buffer
+static bool IndicesInRange(const void *inIndices, UInt32 inIndexSize, UInt32 inNumIndices, UInt32 inNumVertices) {
+    if(!inNumIndices) return true;
+    UInt32 maxIndex = 0;
+    if(inIndexSize == 2) {
+        const UInt16 *indices = (const UInt16*)inIndices;
+        for(UInt32 i = 0; i < inNumIndices; ++i) maxIndex = std::max(maxIndex, UInt32(indices[i]));
+    } else {
+        const UInt32 *indices = (const UInt32*)inIndices;
+        for(UInt32 i = 0; i < inNumIndices; ++i) maxIndex = std::max(maxIndex, indices[i]);
+    }
+    return maxIndex < inNumVertices;
+}
+
+static bool ReadFully(ResourceIo &inIo, UInt8 *outBuffer, UInt inSizeBytes) {
+    UInt offset = 0;
+    while(offset < inSizeBytes) {
+        Int bytesRead = inIo.Read(outBuffer + offset, inSizeBytes - offset).GetResult();
+        if(bytesRead <= 0) return false;
+        offset += UInt(bytesRead);
+    }
+    return true;
+}
+
+bool ResourceMesh::Load(ResourceMemoryAllocator &inAllocator, ResourceDirectory &inDir) {
+    allocator = &inAllocator;
+
+    auto resIo = inDir.Open(GetLocation(), ResourceDirectory::PERMISSION_ReadOnly).GetResult();
+    if(!resIo) return false;
+
+    UInt mappedSize = 0;
+    const UInt8 *mapped = (const UInt8*)resIo->Map(mappedSize);
+    if(mapped && (UInt(mapped) & (MESH_DATA_ALIGNMENT-1)) == 0) {
+        if(mappedSize >= sizeof(MeshFileHeader) && (((const MeshFileHeader*)mapped)->flags & MESH_FILE_FLAG_Compressed)) {
+            return Decompress(mapped, mappedSize);
+        }
+        if(!Parse(mapped, mappedSize)) return false;
+        data = mapped;
+        dataSize = mappedSize;
+        io = resIo;
+        return true;
+    }
+
+    // no usable mapping, the header tells the size so the rest arrives with a single read
+    MeshFileHeader header;
+    UInt size;
+    if(resIo->Read(&header, sizeof(header)).GetResult() != Int(sizeof(header))) return false;
+    if(!GetMeshFileSize(header, size)) return false;
+
+    if(header.flags & MESH_FILE_FLAG_Compressed) {
+        MeshFileCompressed sizes;
+        if(resIo->Read(&sizes, sizeof(sizes)).GetResult() != Int(sizeof(sizes))) return false;
+        UInt64 fileBytes = sizeof(header) + sizeof(sizes) + UInt64(sizes.vertexBytes) + sizes.indexBytes;
+        if(fileBytes > std::numeric_limits<UInt>::max()) return false;
+
+        // the compressed file only lives until it is decoded
+        UInt8 *file = (UInt8*)allocator->Allocate(UInt(fileBytes), MESH_DATA_ALIGNMENT);
+        if(!file) return false;
+        std::memcpy(file, &header, sizeof(header));
+        std::memcpy(file + sizeof(header), &sizes, sizeof(sizes));
+        bool decompressed = ReadFully(*resIo, file + sizeof(header) + sizeof(sizes), UInt(fileBytes) - sizeof(header) - sizeof(sizes))
+                         && Decompress(file, UInt(fileBytes));
+        allocator->Free(file);
+        return decompressed;
+    }
+
+    UInt8 *buffer = (UInt8*)allocator->Allocate(size, MESH_DATA_ALIGNMENT);
+    if(!buffer) return false;
+    std::memcpy(buffer, &header, sizeof(header));
+
+    if(!ReadFully(*resIo, buffer + sizeof(header), size - sizeof(header)) || !Parse(buffer, size)) {
+        allocator->Free(buffer);
+        return false;
+    }
+    data = buffer;
+    dataSize = size;
+    return true;
+}
+
+bool ResourceMesh::Parse(const UInt8 *inData, UInt inSizeBytes, bool hintIndicesChecked) {
+    if(inSizeBytes < sizeof(MeshFileHeader)) return false;
+
+    const MeshFileHeader &header = *(const MeshFileHeader*)inData;
+    UInt size;
+    if(!GetMeshFileSize(header, size) || size > inSizeBytes) return false;
+
+    const Vertex *fileVertices = (const Vertex*)(inData + sizeof(MeshFileHeader));
+    const void *fileIndices = fileVertices + header.numVertices;
+    if(!hintIndicesChecked && !IndicesInRange(fileIndices, header.indexSize, header.numIndices, header.numVertices)) return false;
+
+    vertices = fileVertices;
+    numVertices = header.numVertices;
+    indices = header.numIndices ? fileIndices : 0;
+    numIndices = header.numIndices;
+    indexSize = header.indexSize;
+    boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+    return true;
+}
+
+bool ResourceMesh::Decompress(const UInt8 *inFile, UInt inFileBytes) {
+    static_assert(sizeof(Vertex) == MESH_CODEC_VERTEX_SIZE, "mesh_codec works on Vertex records");
+
+    const MeshFileHeader &header = *(const MeshFileHeader*)inFile;
+    UInt size;
+    if(inFileBytes < sizeof(MeshFileHeader) + sizeof(MeshFileCompressed) || !GetMeshFileSize(header, size)) return false;
+
+    MeshFileCompressed sizes;
+    std::memcpy(&sizes, inFile + sizeof(MeshFileHeader), sizeof(sizes));
+    const UInt8 *payload = inFile + sizeof(MeshFileHeader) + sizeof(MeshFileCompressed);
+    if(UInt64(sizes.vertexBytes) + sizes.indexBytes > inFileBytes - sizeof(MeshFileHeader) - sizeof(MeshFileCompressed)) return false;
+
+    // decoded into the uncompressed layout so Parse and everything after it see no difference
+    UInt8 *buffer = (UInt8*)allocator->Allocate(size, MESH_DATA_ALIGNMENT);
+    if(!buffer) return false;
+    std::memcpy(buffer, &header, sizeof(header));
+    ((MeshFileHeader*)buffer)->flags &= ~MESH_FILE_FLAG_Compressed;
+
+    UInt8 *decodedVertices = buffer + sizeof(MeshFileHeader);
+    UInt8 *decodedIndices = decodedVertices + UInt(header.numVertices)*sizeof(Vertex);
+    bool decoded = MeshDecodeVertices(decodedVertices, header.numVertices, payload, sizes.vertexBytes)
+                && (header.numIndices ? MeshDecodeIndices(decodedIndices, header.indexSize, header.numIndices, header.numVertices, payload + sizes.vertexBytes, sizes.indexBytes)
+                                      : sizes.indexBytes == 0)
+                && Parse(buffer, size, true);
+    if(!decoded) {
+        allocator->Free(buffer);
+        return false;
+    }
+    data = buffer;
+    dataSize = size;
+    return true;
+}
+
+bool ResourceMesh::Unload() {
+    if(!data) return false;
+
+    if(io) {
+        io.reset();
+    } else {
+        allocator->Free((void*)data);
+    }
+    data = 0;
+    dataSize = 0;
+    vertices = 0;
+    numVertices = 0;
+    indices = 0;
+    numIndices = 0;
+    indexSize = 0;
+    return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+/*
+ * Geometry in the .msh format, the vertices of uncompressed files point straight into a mapping
+ * of the file whenever the directory supports it so they can be uploaded without touching them
+ */
+class ResourceMesh : public Resource {
+public:
+    ResourceMesh() : vertices(0), numVertices(0), indices(0), numIndices(0), indexSize(0), data(0), dataSize(0), allocator(0) {}
+    bool Load(ResourceMemoryAllocator &inAllocator, ResourceDirectory &inDir);
+    bool Unload();
+    UInt GetSizeBytes() const { return dataSize; }
+
+    bool IsMapped() const { return io != 0; }
+
+public:
+    const Vertex *vertices;
+    UInt32 numVertices;
+    const void *indices; // UInt16 or UInt32 depending on indexSize, null if not indexed
+    UInt32 numIndices;
+    UInt32 indexSize;
+    glm::vec3 boundsMin, boundsMax;
+
+private:
+    // hintIndicesChecked skips checking every index against numVertices, for indices already checked while decoding
+    bool Parse(const UInt8 *inData, UInt inSizeBytes, bool hintIndicesChecked=false);
+    bool Decompress(const UInt8 *inFile, UInt inFileBytes);
+
+private:
+    const UInt8 *data; // the whole file
+    UInt dataSize;
+    std::shared_ptr<ResourceIo> io; // keeps the mapping alive, null when data was read into an allocation
+    ResourceMemoryAllocator *allocator;
+};
@@ -0,0 +1,308 @@
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MESH_CODEC_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "types.hpp"
+#include "mesh_codec.hpp"
+
+// bits per value for each 2 bit lane mode
+static const UInt32 LANE_BITS[4] = {0, 2, 4, 8};
+
+static inline UInt8 ZigZag8(UInt8 inDelta) {
+    return UInt8((inDelta << 1) ^ (Int8(inDelta) >> 7));
+}
+
+static inline UInt32 ZigZag32(Int32 inDelta) {
+    return (UInt32(inDelta) << 1) ^ UInt32(inDelta >> 31);
+}
+
+static inline Int32 UnZigZag32(UInt32 inValue) {
+    return Int32(inValue >> 1) ^ -Int32(inValue & 1);
+}
+
+// bytes of payload following a group's mode word
+static inline UInt GetGroupBytes(UInt32 inModes) {
+    UInt bytes = 0;
+    for(UInt32 c = 0; c < MESH_CODEC_VERTEX_SIZE; ++c) {
+        bytes += LANE_BITS[(inModes >> (c*2)) & 3]*MESH_CODEC_GROUP_VERTICES/8;
+    }
+    return bytes;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Encoder, used offline by tools/build_mesh so it stays scalar
+
+bool MeshEncodeVertices(const void *inVertices, UInt32 inNumVertices, UInt32 inPositionBits, const float inBoundsMin[3], const float inBoundsMax[3], std::vector<UInt8> &ioData) {
+    if(inPositionBits > 24) return false;
+
+    MeshCodecVertexHeader header;
+    header.positionBits = inPositionBits;
+    float maxQuantized = float((1u << inPositionBits) - 1);
+    for(UInt32 i = 0; i < 3; ++i) {
+        header.offset[i] = inPositionBits ? inBoundsMin[i] : 0.0f;
+        header.scale[i] = inPositionBits ? (inBoundsMax[i] - inBoundsMin[i]) / maxQuantized : 0.0f;
+    }
+    const UInt8 *headerBytes = (const UInt8*)&header;
+    ioData.insert(ioData.end(), headerBytes, headerBytes + sizeof(header));
+
+    // positions become grid coordinates in place of the float bits
+    std::vector<UInt8> records((const UInt8*)inVertices, (const UInt8*)inVertices + UInt(inNumVertices)*MESH_CODEC_VERTEX_SIZE);
+    if(inPositionBits) {
+        for(UInt32 v = 0; v < inNumVertices; ++v) {
+            UInt8 *record = &records[UInt(v)*MESH_CODEC_VERTEX_SIZE];
+            for(UInt32 i = 0; i < 3; ++i) {
+                float value;
+                std::memcpy(&value, record + i*4, 4);
+                float grid = header.scale[i] > 0.0f ? (value - header.offset[i]) / header.scale[i] : 0.0f;
+                UInt32 quantized = UInt32(std::min(std::max(std::floor(grid + 0.5f), 0.0f), maxQuantized));
+                std::memcpy(record + i*4, &quantized, 4);
+            }
+        }
+    }
+
+    UInt8 last[MESH_CODEC_VERTEX_SIZE] = {0};
+    UInt8 lane[MESH_CODEC_GROUP_VERTICES];
+    for(UInt32 first = 0; first < inNumVertices; first += MESH_CODEC_GROUP_VERTICES) {
+        UInt32 count = std::min<UInt32>(MESH_CODEC_GROUP_VERTICES, inNumVertices - first);
+        UInt modesOffset = ioData.size();
+        UInt32 modes = 0;
+        ioData.resize(ioData.size() + sizeof(modes));
+
+        for(UInt32 c = 0; c < MESH_CODEC_VERTEX_SIZE; ++c) {
+            // padding repeats the last value, a zero delta
+            std::memset(lane, 0, sizeof(lane));
+            for(UInt32 v = 0; v < count; ++v) {
+                UInt8 value = records[UInt(first+v)*MESH_CODEC_VERTEX_SIZE + c];
+                lane[v] = ZigZag8(UInt8(value - last[c]));
+                last[c] = value;
+            }
+
+            UInt8 maxValue = *std::max_element(lane, lane + MESH_CODEC_GROUP_VERTICES);
+            UInt32 mode = maxValue == 0 ? 0 : maxValue < 4 ? 1 : maxValue < 16 ? 2 : 3;
+            modes |= mode << (c*2);
+
+            UInt32 bits = LANE_BITS[mode];
+            if(!bits) continue;
+            UInt32 perByte = 8/bits;
+            for(UInt32 i = 0; i < MESH_CODEC_GROUP_VERTICES; i += perByte) {
+                UInt8 packed = 0;
+                for(UInt32 j = 0; j < perByte; ++j) {
+                    packed |= UInt8(lane[i+j] << (j*bits));
+                }
+                ioData.push_back(packed);
+            }
+        }
+        std::memcpy(&ioData[modesOffset], &modes, sizeof(modes));
+    }
+    return true;
+}
+
+void MeshEncodeIndices(const UInt32 *inIndices, UInt32 inNumIndices, std::vector<UInt8> &ioData) {
+    UInt32 last = 0;
+    for(UInt32 i = 0; i < inNumIndices; ++i) {
+        UInt32 value = ZigZag32(Int32(inIndices[i] - last));
+        last = inIndices[i];
+        while(value >= 0x80) {
+            ioData.push_back(UInt8(value | 0x80));
+            value >>= 7;
+        }
+        ioData.push_back(UInt8(value));
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Decoder
+
+#ifdef MESH_CODEC_SSE2
+
+static inline __m128i UnpackLane(const UInt8 *inData, UInt32 inMode) {
+    const __m128i mask2 = _mm_set1_epi8(3), mask4 = _mm_set1_epi8(15);
+    switch(inMode) {
+        case 1: {
+            Int32 packed;
+            std::memcpy(&packed, inData, 4);
+            __m128i b = _mm_cvtsi32_si128(packed);
+            __m128i v0 = _mm_and_si128(b, mask2);
+            __m128i v1 = _mm_and_si128(_mm_srli_epi16(b, 2), mask2);
+            __m128i v2 = _mm_and_si128(_mm_srli_epi16(b, 4), mask2);
+            __m128i v3 = _mm_and_si128(_mm_srli_epi16(b, 6), mask2);
+            return _mm_unpacklo_epi16(_mm_unpacklo_epi8(v0, v1), _mm_unpacklo_epi8(v2, v3));
+        }
+        case 2: {
+            __m128i b = _mm_loadl_epi64((const __m128i*)inData);
+            __m128i lo = _mm_and_si128(b, mask4);
+            __m128i hi = _mm_and_si128(_mm_srli_epi16(b, 4), mask4);
+            return _mm_unpacklo_epi8(lo, hi);
+        }
+        case 3:
+            return _mm_loadu_si128((const __m128i*)inData);
+        default:
+            return _mm_setzero_si128();
+    }
+}
+
+struct DequantizeParams {
+    __m128 scale, offset;
+    __m128i position; // mask of the lanes holding positions, zero when they are stored as floats
+};
+
+// decodes one group of 16 vertices into outRecords, inData already checked to hold the whole group
+static inline const UInt8 *DecodeGroup(const UInt8 *inData, UInt32 inModes, __m128i *ioLast, const DequantizeParams &inDequantize, UInt8 *outRecords) {
+    const __m128i one = _mm_set1_epi8(1), low7 = _mm_set1_epi8(0x7F);
+    __m128i x[MESH_CODEC_VERTEX_SIZE], y[MESH_CODEC_VERTEX_SIZE];
+
+    // every lane is its own running sum, so the 16 of them overlap in the pipeline
+    for(UInt32 c = 0; c < MESH_CODEC_VERTEX_SIZE; ++c) {
+        UInt32 mode = (inModes >> (c*2)) & 3;
+        __m128i z = UnpackLane(inData, mode);
+        inData += LANE_BITS[mode]*MESH_CODEC_GROUP_VERTICES/8;
+
+        __m128i d = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(z, 1), low7), _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(z, one)));
+        d = _mm_add_epi8(d, _mm_slli_si128(d, 1));
+        d = _mm_add_epi8(d, _mm_slli_si128(d, 2));
+        d = _mm_add_epi8(d, _mm_slli_si128(d, 4));
+        d = _mm_add_epi8(d, _mm_slli_si128(d, 8));
+        x[c] = _mm_add_epi8(d, ioLast[c]);
+
+        // broadcast byte 15 for the next group
+        __m128i t = _mm_unpackhi_epi8(x[c], x[c]);
+        t = _mm_shufflehi_epi16(t, 0xFF);
+        ioLast[c] = _mm_unpackhi_epi64(t, t);
+    }
+
+    // lanes to records, four rounds of interleaving halves is a 16x16 transpose
+    for(UInt32 round = 0; round < 2; ++round) {
+        for(UInt32 i = 0; i < 8; ++i) {
+            y[2*i] = _mm_unpacklo_epi8(x[i], x[i+8]);
+            y[2*i+1] = _mm_unpackhi_epi8(x[i], x[i+8]);
+        }
+        for(UInt32 i = 0; i < 8; ++i) {
+            x[2*i] = _mm_unpacklo_epi8(y[i], y[i+8]);
+            x[2*i+1] = _mm_unpackhi_epi8(y[i], y[i+8]);
+        }
+    }
+    // grid coordinates back to floats while the records are still in registers
+    for(UInt32 v = 0; v < MESH_CODEC_GROUP_VERTICES; ++v) {
+        __m128i f = _mm_castps_si128(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(x[v]), inDequantize.scale), inDequantize.offset));
+        __m128i r = _mm_or_si128(_mm_and_si128(f, inDequantize.position), _mm_andnot_si128(inDequantize.position, x[v]));
+        _mm_storeu_si128((__m128i*)(outRecords + v*MESH_CODEC_VERTEX_SIZE), r);
+    }
+    return inData;
+}
+
+bool MeshDecodeVertices(void *outVertices, UInt32 inNumVertices, const UInt8 *inData, UInt inSizeBytes) {
+    MeshCodecVertexHeader header;
+    if(inSizeBytes < sizeof(header)) return false;
+    std::memcpy(&header, inData, sizeof(header));
+    if(header.positionBits > 24) return false;
+
+    const UInt8 *cursor = inData + sizeof(header), *end = inData + inSizeBytes;
+    UInt8 *records = (UInt8*)outVertices;
+    __m128i last[MESH_CODEC_VERTEX_SIZE];
+    for(UInt32 c = 0; c < MESH_CODEC_VERTEX_SIZE; ++c) last[c] = _mm_setzero_si128();
+    UInt8 tail[MESH_CODEC_GROUP_VERTICES*MESH_CODEC_VERTEX_SIZE];
+
+    DequantizeParams dequantize;
+    dequantize.scale = _mm_setr_ps(header.scale[0], header.scale[1], header.scale[2], 0.0f);
+    dequantize.offset = _mm_setr_ps(header.offset[0], header.offset[1], header.offset[2], 0.0f);
+    dequantize.position = header.positionBits ? _mm_setr_epi32(-1, -1, -1, 0) : _mm_setzero_si128();
+
+    for(UInt32 first = 0; first < inNumVertices; first += MESH_CODEC_GROUP_VERTICES) {
+        UInt32 modes;
+        if(UInt(end - cursor) < sizeof(modes)) return false;
+        std::memcpy(&modes, cursor, sizeof(modes));
+        cursor += sizeof(modes);
+        if(UInt(end - cursor) < GetGroupBytes(modes)) return false;
+
+        UInt32 count = std::min<UInt32>(MESH_CODEC_GROUP_VERTICES, inNumVertices - first);
+        UInt8 *out = records + UInt(first)*MESH_CODEC_VERTEX_SIZE;
+        if(count == MESH_CODEC_GROUP_VERTICES) {
+            cursor = DecodeGroup(cursor, modes, last, dequantize, out);
+        } else {
+            // a partial last group must not write past the output
+            cursor = DecodeGroup(cursor, modes, last, dequantize, tail);
+            std::memcpy(out, tail, count*MESH_CODEC_VERTEX_SIZE);
+        }
+    }
+    return cursor == end;
+}
+
+#else
+
+static void Dequantize(UInt8 *ioRecords, UInt32 inNumVertices, const MeshCodecVertexHeader &inHeader) {
+    for(UInt32 v = 0; v < inNumVertices; ++v) {
+        UInt8 *record = ioRecords + UInt(v)*MESH_CODEC_VERTEX_SIZE;
+        for(UInt32 i = 0; i < 3; ++i) {
+            UInt32 quantized;
+            std::memcpy(&quantized, record + i*4, 4);
+            float value = inHeader.offset[i] + float(Int32(quantized))*inHeader.scale[i];
+            std::memcpy(record + i*4, &value, 4);
+        }
+    }
+}
+
+bool MeshDecodeVertices(void *outVertices, UInt32 inNumVertices, const UInt8 *inData, UInt inSizeBytes) {
+    MeshCodecVertexHeader header;
+    if(inSizeBytes < sizeof(header)) return false;
+    std::memcpy(&header, inData, sizeof(header));
+    if(header.positionBits > 24) return false;
+
+    const UInt8 *cursor = inData + sizeof(header), *end = inData + inSizeBytes;
+    UInt8 *records = (UInt8*)outVertices;
+    UInt8 last[MESH_CODEC_VERTEX_SIZE] = {0};
+
+    for(UInt32 first = 0; first < inNumVertices; first += MESH_CODEC_GROUP_VERTICES) {
+        UInt32 modes;
+        if(UInt(end - cursor) < sizeof(modes)) return false;
+        std::memcpy(&modes, cursor, sizeof(modes));
+        cursor += sizeof(modes);
+        if(UInt(end - cursor) < GetGroupBytes(modes)) return false;
+
+        UInt32 count = std::min<UInt32>(MESH_CODEC_GROUP_VERTICES, inNumVertices - first);
+        UInt8 *out = records + UInt(first)*MESH_CODEC_VERTEX_SIZE;
+        for(UInt32 c = 0; c < MESH_CODEC_VERTEX_SIZE; ++c) {
+            UInt32 bits = LANE_BITS[(modes >> (c*2)) & 3];
+            UInt8 mask = UInt8((1u << bits) - 1);
+            for(UInt32 v = 0; v < count; ++v) {
+                UInt8 z = bits ? UInt8((cursor[v*bits/8] >> ((v*bits)&7)) & mask) : 0;
+                last[c] = UInt8(last[c] + ((z >> 1) ^ -(z & 1)));
+                out[v*MESH_CODEC_VERTEX_SIZE + c] = last[c];
+            }
+            cursor += bits*MESH_CODEC_GROUP_VERTICES/8;
+        }
+    }
+    if(cursor != end) return false;
+
+    if(header.positionBits) Dequantize(records, inNumVertices, header);
+    return true;
+}
+
+#endif
+
+bool MeshDecodeIndices(void *outIndices, UInt32 inIndexSize, UInt32 inNumIndices, UInt32 inNumVertices, const UInt8 *inData, UInt inSizeBytes) {
+    if(inIndexSize != 2 && inIndexSize != 4) return false;
+
+    const UInt8 *end = inData + inSizeBytes;
+    UInt32 last = 0;
+    for(UInt32 i = 0; i < inNumIndices; ++i) {
+        UInt32 value = 0;
+        for(UInt32 shift = 0;; shift += 7) {
+            if(inData == end || shift > 28) return false;
+            UInt8 b = *inData++;
+            value |= UInt32(b & 0x7F) << shift;
+            if(!(b & 0x80)) break;
+        }
+        last += UInt32(UnZigZag32(value));
+        if(last >= inNumVertices) return false;
+
+        if(inIndexSize == 2) ((UInt16*)outIndices)[i] = UInt16(last);
+        else ((UInt32*)outIndices)[i] = last;
+    }
+    return inData == end;
+}
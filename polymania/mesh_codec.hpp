@@ -0,0 +1,28 @@
+#pragma once
+
+#define MESH_CODEC_VERTEX_SIZE 16 // bytes per vertex record, laid out like Vertex: float x,y,z then 4 bytes
+#define MESH_CODEC_GROUP_VERTICES 16 // vertices sharing one word of bit widths
+
+/*
+ * Compression for .msh payloads
+ *
+ * Vertices are optionally quantized to a grid over the bounds, then every byte of the record is
+ * delta coded against the previous vertex, zigzagged and packed 16 vertices at a time with 0, 2, 4 or 8 bits
+ * per byte. The 16 byte lanes of a group decode independently, which the SSE2 decoder exploits before
+ * transposing them back into records. Indices are delta and zigzag coded into varints.
+ */
+
+struct MeshCodecVertexHeader {
+    UInt32 positionBits; // 0 keeps positions as exact floats
+    float offset[3]; // position = offset + quantized*scale
+    float scale[3];
+};
+
+// appends the encoded records to ioData, inPositionBits of 1 to 24 quantizes positions within the bounds
+bool MeshEncodeVertices(const void *inVertices, UInt32 inNumVertices, UInt32 inPositionBits, const float inBoundsMin[3], const float inBoundsMax[3], std::vector<UInt8> &ioData);
+// false if inData is not exactly inNumVertices encoded records
+bool MeshDecodeVertices(void *outVertices, UInt32 inNumVertices, const UInt8 *inData, UInt inSizeBytes);
+
+void MeshEncodeIndices(const UInt32 *inIndices, UInt32 inNumIndices, std::vector<UInt8> &ioData);
+// writes 2 or 4 byte indices, false on malformed data or an index not below inNumVertices
+bool MeshDecodeIndices(void *outIndices, UInt32 inIndexSize, UInt32 inNumIndices, UInt32 inNumVertices, const UInt8 *inData, UInt inSizeBytes);
@@ -0,0 +1,27 @@
+#pragma once
+
+#define MESH_FILE_MAGIC 0x48534D50 // "PMSH" read as a little endian UInt32
+#define MESH_FILE_VERSION 1
+
+#define MESH_FILE_FLAG_Compressed 1 // the header is followed by MeshFileCompressed and the mesh_codec streams
+
+/*
+ * Layout of .msh files, little endian and identical to what is handed to GL:
+ * the header, numVertices vertices of vertexSize bytes each, then numIndices indices of indexSize bytes each
+ */
+struct MeshFileHeader {
+    UInt32 magic;
+    UInt16 version;
+    UInt16 indexSize; // 2 or 4, 0 if the mesh is not indexed
+    UInt32 vertexSize; // sizeof(Vertex) of the writer, loading fails on a mismatch
+    UInt32 numVertices;
+    UInt32 numIndices;
+    UInt32 flags; // MESH_FILE_FLAG_*
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+struct MeshFileCompressed {
+    UInt32 vertexBytes; // MeshEncodeVertices output
+    UInt32 indexBytes; // MeshEncodeIndices output, right after the vertices
+};
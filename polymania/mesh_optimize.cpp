@@ -0,0 +1,202 @@
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "types.hpp"
+#include "mesh_optimize.hpp"
+
+// Forsyth's tuning, see "Linear-Speed Vertex Cache Optimisation"
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+static const UInt32 NO_INDEX = ~0u;
+
+static inline UInt32 HashBytes(const UInt8 *inBytes, UInt32 inSize) {
+    // FNV-1a
+    UInt32 hash = 2166136261u;
+    for(UInt32 i = 0; i < inSize; ++i) {
+        hash = (hash ^ inBytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+UInt32 MeshDeduplicateVertices(const void *inVertices, UInt32 inNumVertices, UInt32 inVertexSize, const UInt32 *inIndices, UInt32 inNumIndices,
+                               std::vector<UInt8> &outVertices, std::vector<UInt32> &outIndices) {
+    UInt32 numReferences = inIndices ? inNumIndices : inNumVertices;
+    outVertices.clear();
+    outVertices.reserve(UInt(inNumVertices)*inVertexSize);
+    outIndices.resize(numReferences);
+
+    // open addressing table of unique vertex numbers, kept under half full
+    UInt32 tableSize = 16;
+    while(tableSize < numReferences*2) tableSize <<= 1;
+    std::vector<UInt32> table(tableSize, NO_INDEX);
+
+    const UInt8 *vertices = (const UInt8*)inVertices;
+    UInt32 numUnique = 0;
+    for(UInt32 i = 0; i < numReferences; ++i) {
+        const UInt8 *vertex = vertices + UInt(inIndices ? inIndices[i] : i)*inVertexSize;
+        UInt32 slot = HashBytes(vertex, inVertexSize) & (tableSize - 1);
+        for(;;) {
+            UInt32 unique = table[slot];
+            if(unique == NO_INDEX) {
+                table[slot] = numUnique;
+                outVertices.insert(outVertices.end(), vertex, vertex + inVertexSize);
+                outIndices[i] = numUnique++;
+                break;
+            }
+            if(std::memcmp(&outVertices[UInt(unique)*inVertexSize], vertex, inVertexSize) == 0) {
+                outIndices[i] = unique;
+                break;
+            }
+            slot = (slot + 1) & (tableSize - 1);
+        }
+    }
+    return numUnique;
+}
+
+// how much emitting one more triangle with this vertex is worth, -1 once it has none left
+static float GetVertexScore(Int32 inCachePosition, UInt32 inRemaining, UInt32 inCacheSize) {
+    if(inRemaining == 0) return -1.0f;
+
+    float score = 0.0f;
+    if(inCachePosition >= 0) {
+        // the last triangle's vertices get a fixed score so the next one does not simply share an edge with it
+        if(inCachePosition < 3) score = LAST_TRIANGLE_SCORE;
+        else score = std::pow(1.0f - float(inCachePosition - 3) / float(inCacheSize - 3), CACHE_DECAY_POWER);
+    }
+    // vertices with few triangles left are finished off first
+    return score + VALENCE_BOOST_SCALE * std::pow(float(inRemaining), -VALENCE_BOOST_POWER);
+}
+
+void MeshOptimizeVertexCache(UInt32 *ioIndices, UInt32 inNumIndices, UInt32 inNumVertices, UInt32 inCacheSize) {
+    UInt32 numTriangles = inNumIndices / 3;
+    if(numTriangles < 2) return;
+    if(inCacheSize < 4) inCacheSize = 4;
+
+    // triangles of every vertex, the first remaining[v] entries of its list are the ones not emitted yet
+    std::vector<UInt32> remaining(inNumVertices, 0);
+    for(UInt32 i = 0; i < numTriangles*3; ++i) {
+        remaining[ioIndices[i]]++;
+    }
+    std::vector<UInt32> offsets(inNumVertices + 1, 0);
+    for(UInt32 v = 0; v < inNumVertices; ++v) {
+        offsets[v + 1] = offsets[v] + remaining[v];
+    }
+    std::vector<UInt32> adjacency(numTriangles*3);
+    std::vector<UInt32> fill(offsets.begin(), offsets.end() - 1);
+    for(UInt32 i = 0; i < numTriangles*3; ++i) {
+        adjacency[fill[ioIndices[i]]++] = i / 3;
+    }
+
+    std::vector<Int32> cachePosition(inNumVertices, -1);
+    std::vector<float> vertexScore(inNumVertices);
+    for(UInt32 v = 0; v < inNumVertices; ++v) {
+        vertexScore[v] = GetVertexScore(-1, remaining[v], inCacheSize);
+    }
+
+    std::vector<bool> emitted(numTriangles, false);
+    UInt32 best = 0;
+    float bestScore = -1.0f;
+    for(UInt32 t = 0; t < numTriangles; ++t) {
+        const UInt32 *tri = ioIndices + t*3;
+        float score = vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+        if(score > bestScore) {
+            bestScore = score;
+            best = t;
+        }
+    }
+
+    std::vector<UInt32> output;
+    output.reserve(numTriangles*3);
+    std::vector<UInt32> cache, nextCache;
+    cache.reserve(inCacheSize + 3);
+    nextCache.reserve(inCacheSize + 3);
+    UInt32 cursor = 0; // no triangle before it is left
+    while(best != NO_INDEX) {
+        emitted[best] = true;
+        const UInt32 *tri = ioIndices + best*3;
+        output.insert(output.end(), tri, tri + 3);
+
+        nextCache.clear();
+        for(UInt32 k = 0; k < 3; ++k) {
+            UInt32 v = tri[k];
+            UInt32 *list = &adjacency[offsets[v]];
+            UInt32 *last = list + remaining[v] - 1;
+            *std::find(list, last, best) = *last;
+            remaining[v]--;
+            if(std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end()) nextCache.push_back(v);
+        }
+        // the rest of the cache moves back behind the triangle, whatever ends up past inCacheSize is evicted
+        for(auto it = cache.begin(); it != cache.end(); ++it) {
+            if(*it != tri[0] && *it != tri[1] && *it != tri[2]) nextCache.push_back(*it);
+        }
+        for(UInt32 i = 0; i < nextCache.size(); ++i) {
+            UInt32 v = nextCache[i];
+            cachePosition[v] = i < inCacheSize ? Int32(i) : -1;
+            vertexScore[v] = GetVertexScore(cachePosition[v], remaining[v], inCacheSize);
+        }
+
+        // only triangles touching those vertices changed score, the best of them goes next
+        best = NO_INDEX;
+        bestScore = -1.0f;
+        for(auto it = nextCache.begin(); it != nextCache.end(); ++it) {
+            const UInt32 *list = &adjacency[offsets[*it]];
+            for(UInt32 j = 0; j < remaining[*it]; ++j) {
+                UInt32 t = list[j];
+                const UInt32 *other = ioIndices + t*3;
+                float score = vertexScore[other[0]] + vertexScore[other[1]] + vertexScore[other[2]];
+                if(score > bestScore) {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+        if(nextCache.size() > inCacheSize) nextCache.resize(inCacheSize);
+        cache.swap(nextCache);
+
+        if(best == NO_INDEX) {
+            // nothing in the cache has triangles left, carry on with any remaining one
+            while(cursor < numTriangles && emitted[cursor]) cursor++;
+            if(cursor < numTriangles) best = cursor;
+        }
+    }
+
+    std::memcpy(ioIndices, &output[0], output.size()*sizeof(UInt32));
+}
+
+void MeshOptimizeVertexFetch(void *ioVertices, UInt32 inNumVertices, UInt32 inVertexSize, UInt32 *ioIndices, UInt32 inNumIndices) {
+    std::vector<UInt32> remap(inNumVertices, NO_INDEX);
+    UInt32 next = 0;
+    for(UInt32 i = 0; i < inNumIndices; ++i) {
+        UInt32 &vertex = remap[ioIndices[i]];
+        if(vertex == NO_INDEX) vertex = next++;
+        ioIndices[i] = vertex;
+    }
+    for(UInt32 v = 0; v < inNumVertices; ++v) {
+        if(remap[v] == NO_INDEX) remap[v] = next++;
+    }
+
+    UInt8 *vertices = (UInt8*)ioVertices;
+    std::vector<UInt8> original(vertices, vertices + UInt(inNumVertices)*inVertexSize);
+    for(UInt32 v = 0; v < inNumVertices; ++v) {
+        std::memcpy(vertices + UInt(remap[v])*inVertexSize, &original[UInt(v)*inVertexSize], inVertexSize);
+    }
+}
+
+float MeshComputeAcmr(const UInt32 *inIndices, UInt32 inNumIndices, UInt32 inCacheSize) {
+    if(inNumIndices < 3 || inCacheSize == 0) return 0.0f;
+
+    std::vector<UInt32> fifo(inCacheSize, NO_INDEX);
+    UInt32 head = 0, misses = 0;
+    for(UInt32 i = 0; i < inNumIndices; ++i) {
+        if(std::find(fifo.begin(), fifo.end(), inIndices[i]) != fifo.end()) continue;
+        misses++;
+        fifo[head] = inIndices[i];
+        head = (head + 1) % inCacheSize;
+    }
+    return float(misses) / float(inNumIndices / 3);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#define MESH_VERTEX_CACHE_SIZE 32 // entries of the post-transform cache the triangle order is tuned for
+
+/*
+ * Offline preparation of indexed triangle lists, used by tools/build_mesh
+ *
+ * A typical run is MeshDeduplicateVertices to turn a plain triangle list into an indexed one,
+ * MeshOptimizeVertexCache to order the triangles so their vertices are still in the post-transform
+ * cache when they are reused, then MeshOptimizeVertexFetch so the vertices are read in the same order.
+ */
+
+// merges byte identical vertices of inVertexSize bytes. inIndices may be null to treat inVertices as a
+// triangle list. outVertices holds the unique vertices in order of first use and outIndices addresses them.
+// Returns the number of unique vertices
+UInt32 MeshDeduplicateVertices(const void *inVertices, UInt32 inNumVertices, UInt32 inVertexSize, const UInt32 *inIndices, UInt32 inNumIndices,
+                               std::vector<UInt8> &outVertices, std::vector<UInt32> &outIndices);
+
+// reorders the triangles in place with Forsyth's linear speed vertex cache optimization
+void MeshOptimizeVertexCache(UInt32 *ioIndices, UInt32 inNumIndices, UInt32 inNumVertices, UInt32 inCacheSize=MESH_VERTEX_CACHE_SIZE);
+
+// renumbers the vertices in order of first use by ioIndices, vertices no index refers to move to the end
+void MeshOptimizeVertexFetch(void *ioVertices, UInt32 inNumVertices, UInt32 inVertexSize, UInt32 *ioIndices, UInt32 inNumIndices);
+
+// average vertex shader invocations per triangle with a FIFO cache of inCacheSize, between 0.5 and 3
+float MeshComputeAcmr(const UInt32 *inIndices, UInt32 inNumIndices, UInt32 inCacheSize);
@@ -16,6 +16,7 @@
 #include "context_glfw.hpp"
 
 #include "../types.hpp"
+#include "../render_state.hpp"
 #include "../object.hpp"
 #include "../globals.hpp"
 
@@ -24,7 +25,7 @@
 static void OnResize(GLFWwindow *window, Int32 w, Int32 h) {
     auto data = Event::MakeEventData("inWidth", w)("inHeight",h);
     ((Object*)GGameSys)->Send(Event("ResizedWindow", data));
-    glViewport (0, 0, (GLsizei) w, (GLsizei) h);
+    RenderState::SetViewport(0, 0, w, h);
 }
 
 inline GLFWwindow *CreateContext(const char *hintTitle,  int hintWidth, int hintHeight, bool hintFullscreen) {
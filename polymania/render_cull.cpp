@@ -0,0 +1,260 @@
+#if defined(RENDER_CULL_SCALAR)
+// SIMD turned off, e.g. for the scalar numbers of tools/cull_bench
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RENDER_CULL_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define RENDER_CULL_NEON
+#include <arm_neon.h>
+#endif
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "types.hpp"
+#include "render_cull.hpp"
+
+RenderFrustum::RenderFrustum(const glm::mat4 &inViewProjection) {
+    // Gribb and Hartmann, the planes are sums and differences of the matrix rows (glm is column major)
+    const glm::mat4 &m = inViewProjection;
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    planes[PLANE_Left] = row3 + row0;
+    planes[PLANE_Right] = row3 - row0;
+    planes[PLANE_Bottom] = row3 + row1;
+    planes[PLANE_Top] = row3 - row1;
+    planes[PLANE_Near] = row3 + row2;
+    planes[PLANE_Far] = row3 - row2;
+    for(UInt32 i = 0; i < NUM_PLANES; ++i) {
+        float length = glm::length(glm::vec3(planes[i]));
+        if(length > 0.0f) planes[i] /= length;
+    }
+}
+
+bool RenderFrustum::ClipBox(const glm::vec3 &inMin, const glm::vec3 &inMax, UInt32 &ioMask) const {
+    glm::vec3 center = (inMin + inMax)*0.5f;
+    glm::vec3 extent = (inMax - inMin)*0.5f;
+    for(UInt32 p = 0; p < NUM_PLANES; ++p) {
+        if(!(ioMask & (1u << p))) continue;
+        const glm::vec4 &plane = planes[p];
+        float distance = plane.x*center.x + plane.y*center.y + plane.z*center.z + plane.w;
+        float reach = std::fabs(plane.x)*extent.x + std::fabs(plane.y)*extent.y + std::fabs(plane.z)*extent.z;
+        if(distance < -reach) return false;
+        if(distance >= reach) ioMask &= ~(1u << p);
+    }
+    return true;
+}
+
+RenderCullSet::RenderCullSet() {
+}
+
+RenderCullSet::~RenderCullSet() {
+}
+
+UInt32 RenderCullSet::Add() {
+    UInt32 index = GetSize();
+    centerX.push_back(0.0f);
+    centerY.push_back(0.0f);
+    centerZ.push_back(0.0f);
+    extentX.push_back(0.0f);
+    extentY.push_back(0.0f);
+    extentZ.push_back(0.0f);
+    radius.push_back(0.0f);
+    return index;
+}
+
+UInt32 RenderCullSet::AddBox(const glm::vec3 &inMin, const glm::vec3 &inMax) {
+    UInt32 index = Add();
+    SetBox(index, inMin, inMax);
+    return index;
+}
+
+UInt32 RenderCullSet::AddSphere(const glm::vec3 &inCenter, float inRadius) {
+    UInt32 index = Add();
+    SetSphere(index, inCenter, inRadius);
+    return index;
+}
+
+void RenderCullSet::SetBox(UInt32 inIndex, const glm::vec3 &inMin, const glm::vec3 &inMax) {
+    glm::vec3 center = (inMin + inMax)*0.5f;
+    glm::vec3 extent = (inMax - inMin)*0.5f;
+    centerX[inIndex] = center.x;
+    centerY[inIndex] = center.y;
+    centerZ[inIndex] = center.z;
+    extentX[inIndex] = extent.x;
+    extentY[inIndex] = extent.y;
+    extentZ[inIndex] = extent.z;
+    // the sphere around the box, never tighter than the box itself
+    radius[inIndex] = glm::length(extent);
+}
+
+void RenderCullSet::SetSphere(UInt32 inIndex, const glm::vec3 &inCenter, float inRadius) {
+    centerX[inIndex] = inCenter.x;
+    centerY[inIndex] = inCenter.y;
+    centerZ[inIndex] = inCenter.z;
+    // the box around the sphere, never tighter than the sphere itself
+    extentX[inIndex] = inRadius;
+    extentY[inIndex] = inRadius;
+    extentZ[inIndex] = inRadius;
+    radius[inIndex] = inRadius;
+}
+
+void RenderCullSet::Remove(UInt32 inIndex) {
+    UInt32 last = GetSize() - 1;
+    centerX[inIndex] = centerX[last];
+    centerY[inIndex] = centerY[last];
+    centerZ[inIndex] = centerZ[last];
+    extentX[inIndex] = extentX[last];
+    extentY[inIndex] = extentY[last];
+    extentZ[inIndex] = extentZ[last];
+    radius[inIndex] = radius[last];
+    centerX.pop_back();
+    centerY.pop_back();
+    centerZ.pop_back();
+    extentX.pop_back();
+    extentY.pop_back();
+    extentZ.pop_back();
+    radius.pop_back();
+}
+
+void RenderCullSet::Clear() {
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    extentX.clear();
+    extentY.clear();
+    extentZ.clear();
+    radius.clear();
+}
+
+UInt32 RenderCullSet::CullScalar(const RenderFrustum &inFrustum, UInt32 inBegin, UInt32 inEnd, UInt32 *outVisible) const {
+    UInt32 numVisible = 0;
+    for(UInt32 i = inBegin; i < inEnd; ++i) {
+        bool inside = true;
+        for(UInt32 p = 0; p < RenderFrustum::NUM_PLANES && inside; ++p) {
+            const glm::vec4 &plane = inFrustum.planes[p];
+            float distance = plane.x*centerX[i] + plane.y*centerY[i] + plane.z*centerZ[i] + plane.w;
+            // how far the box reaches towards the plane
+            float boxRadius = std::fabs(plane.x)*extentX[i] + std::fabs(plane.y)*extentY[i] + std::fabs(plane.z)*extentZ[i];
+            inside = distance >= -std::min(boxRadius, radius[i]);
+        }
+        if(inside) outVisible[numVisible++] = i;
+    }
+    return numVisible;
+}
+
+#if defined(RENDER_CULL_SSE)
+struct RenderCullSet::SimdPlanes {
+    __m128 x[RenderFrustum::NUM_PLANES], y[RenderFrustum::NUM_PLANES], z[RenderFrustum::NUM_PLANES], w[RenderFrustum::NUM_PLANES];
+    __m128 absX[RenderFrustum::NUM_PLANES], absY[RenderFrustum::NUM_PLANES], absZ[RenderFrustum::NUM_PLANES];
+
+    SimdPlanes(const RenderFrustum &inFrustum) {
+        for(UInt32 p = 0; p < RenderFrustum::NUM_PLANES; ++p) {
+            const glm::vec4 &plane = inFrustum.planes[p];
+            x[p] = _mm_set1_ps(plane.x);
+            y[p] = _mm_set1_ps(plane.y);
+            z[p] = _mm_set1_ps(plane.z);
+            w[p] = _mm_set1_ps(plane.w);
+            absX[p] = _mm_set1_ps(std::fabs(plane.x));
+            absY[p] = _mm_set1_ps(std::fabs(plane.y));
+            absZ[p] = _mm_set1_ps(std::fabs(plane.z));
+        }
+    }
+};
+
+UInt32 RenderCullSet::CullGroup(const SimdPlanes &inPlanes, UInt32 inFirst) const {
+    UInt32 i = inFirst;
+    __m128 cx = _mm_loadu_ps(&centerX[i]), cy = _mm_loadu_ps(&centerY[i]), cz = _mm_loadu_ps(&centerZ[i]);
+    __m128 ex = _mm_loadu_ps(&extentX[i]), ey = _mm_loadu_ps(&extentY[i]), ez = _mm_loadu_ps(&extentZ[i]);
+    __m128 r = _mm_loadu_ps(&radius[i]);
+    __m128 outside = _mm_setzero_ps();
+    for(UInt32 p = 0; p < RenderFrustum::NUM_PLANES; ++p) {
+        // summed in the same order as CullScalar, so both paths agree on objects touching a plane
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(inPlanes.x[p], cx), _mm_mul_ps(inPlanes.y[p], cy)), _mm_mul_ps(inPlanes.z[p], cz)), inPlanes.w[p]);
+        __m128 boxRadius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(inPlanes.absX[p], ex), _mm_mul_ps(inPlanes.absY[p], ey)), _mm_mul_ps(inPlanes.absZ[p], ez));
+        // distance < -reach, written as distance + reach < 0
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, _mm_min_ps(boxRadius, r)), _mm_setzero_ps()));
+    }
+    return ~UInt32(_mm_movemask_ps(outside)) & 0xF;
+}
+#elif defined(RENDER_CULL_NEON)
+struct RenderCullSet::SimdPlanes {
+    float32x4_t x[RenderFrustum::NUM_PLANES], y[RenderFrustum::NUM_PLANES], z[RenderFrustum::NUM_PLANES], w[RenderFrustum::NUM_PLANES];
+    float32x4_t absX[RenderFrustum::NUM_PLANES], absY[RenderFrustum::NUM_PLANES], absZ[RenderFrustum::NUM_PLANES];
+
+    SimdPlanes(const RenderFrustum &inFrustum) {
+        for(UInt32 p = 0; p < RenderFrustum::NUM_PLANES; ++p) {
+            const glm::vec4 &plane = inFrustum.planes[p];
+            x[p] = vdupq_n_f32(plane.x);
+            y[p] = vdupq_n_f32(plane.y);
+            z[p] = vdupq_n_f32(plane.z);
+            w[p] = vdupq_n_f32(plane.w);
+            absX[p] = vdupq_n_f32(std::fabs(plane.x));
+            absY[p] = vdupq_n_f32(std::fabs(plane.y));
+            absZ[p] = vdupq_n_f32(std::fabs(plane.z));
+        }
+    }
+};
+
+UInt32 RenderCullSet::CullGroup(const SimdPlanes &inPlanes, UInt32 inFirst) const {
+    UInt32 i = inFirst;
+    float32x4_t cx = vld1q_f32(&centerX[i]), cy = vld1q_f32(&centerY[i]), cz = vld1q_f32(&centerZ[i]);
+    float32x4_t ex = vld1q_f32(&extentX[i]), ey = vld1q_f32(&extentY[i]), ez = vld1q_f32(&extentZ[i]);
+    float32x4_t r = vld1q_f32(&radius[i]);
+    uint32x4_t outside = vdupq_n_u32(0);
+    for(UInt32 p = 0; p < RenderFrustum::NUM_PLANES; ++p) {
+        float32x4_t distance = vaddq_f32(vmlaq_f32(vmlaq_f32(vmulq_f32(inPlanes.x[p], cx), inPlanes.y[p], cy), inPlanes.z[p], cz), inPlanes.w[p]);
+        float32x4_t boxRadius = vmlaq_f32(vmlaq_f32(vmulq_f32(inPlanes.absX[p], ex), inPlanes.absY[p], ey), inPlanes.absZ[p], ez);
+        outside = vorrq_u32(outside, vcltq_f32(vaddq_f32(distance, vminq_f32(boxRadius, r)), vdupq_n_f32(0.0f)));
+    }
+    return (vgetq_lane_u32(outside, 0) ? 0 : 1) | (vgetq_lane_u32(outside, 1) ? 0 : 2) |
+           (vgetq_lane_u32(outside, 2) ? 0 : 4) | (vgetq_lane_u32(outside, 3) ? 0 : 8);
+}
+#endif
+
+void RenderCullSet::Cull(const RenderFrustum &inFrustum, std::vector<UInt32> &ioVisible) const {
+    UInt32 all[2] = {0, GetSize()};
+    CullRanges(inFrustum, all, 1, ioVisible);
+}
+
+void RenderCullSet::CullRanges(const RenderFrustum &inFrustum, const UInt32 *inRanges, UInt32 inNumRanges, std::vector<UInt32> &ioVisible) const {
+    UInt numObjects = 0;
+    for(UInt32 r = 0; r < inNumRanges; ++r) {
+        numObjects += inRanges[2*r + 1] - inRanges[2*r];
+    }
+    if(!numObjects) return;
+
+    // room for everything, trimmed to what was written at the end
+    UInt first = ioVisible.size();
+    ioVisible.resize(first + numObjects);
+    UInt32 *out = &ioVisible[0] + first;
+
+#if defined(RENDER_CULL_SSE) || defined(RENDER_CULL_NEON)
+    SimdPlanes planes(inFrustum);
+#endif
+    for(UInt32 r = 0; r < inNumRanges; ++r) {
+        UInt32 i = inRanges[2*r], end = inRanges[2*r + 1];
+#if defined(RENDER_CULL_SSE) || defined(RENDER_CULL_NEON)
+        // a short tail still goes four wide when the objects after it exist, their lanes are masked off
+        for(; i < end && i + 4 <= GetSize(); i += 4) {
+            UInt32 visible = CullGroup(planes, i);
+            if(end - i < 4) visible &= (1u << (end - i)) - 1;
+            while(visible) {
+                UInt32 lane = 0;
+                while(!(visible & (1u << lane))) lane++;
+                *out++ = i + lane;
+                visible &= visible - 1;
+            }
+        }
+        if(i > end) i = end;
+#endif
+        out += CullScalar(inFrustum, i, end, out);
+    }
+    ioVisible.resize(UInt(out - &ioVisible[0]));
+}
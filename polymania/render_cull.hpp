@@ -0,0 +1,62 @@
+#pragma once
+
+// the six planes of a view volume, normals point inside and are unit length so distances are in world units
+struct RenderFrustum {
+    enum {
+        PLANE_Left,
+        PLANE_Right,
+        PLANE_Bottom,
+        PLANE_Top,
+        PLANE_Near,
+        PLANE_Far,
+        NUM_PLANES
+    };
+
+    glm::vec4 planes[NUM_PLANES]; // xyz normal, w distance from the origin
+
+    // extracted from projection*modelview, inside means in front of every plane
+    explicit RenderFrustum(const glm::mat4 &inViewProjection);
+
+    // false when the box is outside one of the planes set in ioMask (bit per PLANE_), otherwise clears
+    // the planes it is entirely inside of, for hierarchies whose children need not test those again
+    bool ClipBox(const glm::vec3 &inMin, const glm::vec3 &inMax, UInt32 &ioMask) const;
+};
+
+/*
+ * Object bounds packed as structure of arrays and culled against a frustum four at a time with SSE or NEON,
+ * one by one elsewhere. Every object has a box and a sphere, whichever is tighter against a plane counts
+ */
+class RenderCullSet {
+public:
+    RenderCullSet();
+    ~RenderCullSet();
+
+    // return the index reported by Cull
+    UInt32 AddBox(const glm::vec3 &inMin, const glm::vec3 &inMax);
+    UInt32 AddSphere(const glm::vec3 &inCenter, float inRadius);
+    void SetBox(UInt32 inIndex, const glm::vec3 &inMin, const glm::vec3 &inMax);
+    void SetSphere(UInt32 inIndex, const glm::vec3 &inCenter, float inRadius);
+    // the last object takes inIndex's place
+    void Remove(UInt32 inIndex);
+    void Clear();
+    UInt32 GetSize() const { return UInt32(centerX.size()); }
+
+    // appends the indices of the objects at least partially inside inFrustum to ioVisible, in ascending order
+    void Cull(const RenderFrustum &inFrustum, std::vector<UInt32> &ioVisible) const;
+    // same for the objects in [inRanges[2*i], inRanges[2*i + 1]) of each of inNumRanges ranges, in the order given
+    void CullRanges(const RenderFrustum &inFrustum, const UInt32 *inRanges, UInt32 inNumRanges, std::vector<UInt32> &ioVisible) const;
+
+private:
+    struct SimdPlanes; // the frustum's planes splatted across the lanes, only defined with SSE or NEON
+
+private:
+    UInt32 Add();
+    UInt32 CullScalar(const RenderFrustum &inFrustum, UInt32 inBegin, UInt32 inEnd, UInt32 *outVisible) const;
+    // bit per visible object of the four starting at inFirst
+    UInt32 CullGroup(const SimdPlanes &inPlanes, UInt32 inFirst) const;
+
+private:
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ; // half the box size
+    std::vector<float> radius;
+};
@@ -0,0 +1,212 @@
+#ifdef __arm__
+#include <GLES2/gl2.h>
+#include <EGL/egl.h>
+#define GLFW_INCLUDE_ES2
+#else
+#include <GL/glew.h>
+#endif
+
+#include <glm/glm.hpp>
+
+#include <cstring>
+#include <cstddef>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <list>
+#include <atomic>
+#include <mutex>
+#include <memory>
+
+#include "types.hpp"
+#include "asyncmodel.hpp"
+#include "resource.hpp"
+#include "vertex_layout.hpp"
+#include "shader.hpp"
+#include "render_list.hpp"
+#include "render_instance.hpp"
+#include "render_state.hpp"
+#include "render_vao.hpp"
+
+static const VertexAttribute instanceAttributes[] = {
+    VERTEX_ATTRIBUTE(InstanceData, row0, "in_InstanceRow0", false),
+    VERTEX_ATTRIBUTE(InstanceData, row1, "in_InstanceRow1", false),
+    VERTEX_ATTRIBUTE(InstanceData, row2, "in_InstanceRow2", false),
+    VERTEX_ATTRIBUTE_ARRAY(InstanceData, r, 4, "in_InstanceColor", true)
+};
+DEFINE_VERTEX_LAYOUT(InstanceData, instanceAttributes)
+
+// refills inBufferId with inSizeBytes of inData, orphaning the old storage so the GPU can keep reading it
+static void StreamBuffer(UInt32 inBufferId, UInt &ioBufferSize, const void *inData, UInt inSizeBytes) {
+    RenderState::BindBuffer(GL_ARRAY_BUFFER, inBufferId);
+    if(inSizeBytes > ioBufferSize) {
+        ioBufferSize = inSizeBytes;
+        glBufferData(GL_ARRAY_BUFFER, ioBufferSize, inData, GL_STREAM_DRAW);
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, ioBufferSize, 0, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, inSizeBytes, inData);
+    }
+}
+
+RenderInstancer::RenderInstancer(UInt32 inInstancesPerBatch) : shader(0), hardware(IsHardwareSupported()),
+                                                               meshVertices(0), nMeshVertices(0), meshIndices(0), nMeshIndices(0), meshIndexSize(0),
+                                                               meshVboId(0), meshIboId(0), instanceVboId(0), instanceBufferSize(0), nUploaded(0),
+                                                               expandedVboId(0), expandedBufferSize(0) {
+    instances.reserve(inInstancesPerBatch);
+    if(hardware) {
+        glGenBuffers(1, &meshVboId);
+        glGenBuffers(1, &meshIboId);
+        glGenBuffers(1, &instanceVboId);
+    } else {
+        glGenBuffers(1, &expandedVboId);
+    }
+}
+
+RenderInstancer::~RenderInstancer() {
+    RenderState::DeleteBuffer(meshVboId);
+    RenderState::DeleteBuffer(meshIboId);
+    RenderState::DeleteBuffer(instanceVboId);
+    RenderState::DeleteBuffer(expandedVboId);
+}
+
+bool RenderInstancer::IsHardwareSupported() {
+#ifdef __arm__
+    return false;
+#else
+    return (GLEW_VERSION_3_3 || GLEW_ARB_instanced_arrays) && (GLEW_VERSION_3_1 || GLEW_ARB_draw_instanced || GLEW_ARB_instanced_arrays);
+#endif
+}
+
+void RenderInstancer::SetShader(const Shader &inShader) {
+    shader = &inShader;
+}
+
+void RenderInstancer::SetMesh(const Vertex *inVertices, UInt32 inNumVertices, const void *inIndices, UInt32 inNumIndices, UInt32 inIndexSize) {
+    meshVertices = inVertices;
+    nMeshVertices = inNumVertices;
+    meshIndices = inIndices;
+    nMeshIndices = inIndices ? inNumIndices : 0;
+    meshIndexSize = inIndices ? inIndexSize : 0;
+    if(!hardware) return;
+
+    RenderState::BindBuffer(GL_ARRAY_BUFFER, meshVboId);
+    glBufferData(GL_ARRAY_BUFFER, UInt(inNumVertices)*sizeof(Vertex), inVertices, GL_STATIC_DRAW);
+    if(nMeshIndices) {
+        RenderVaoCache::BindDefault();
+        RenderState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshIboId);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, UInt(nMeshIndices)*meshIndexSize, inIndices, GL_STATIC_DRAW);
+    }
+}
+
+void RenderInstancer::Queue(const InstanceData &inInstance) {
+    instances.push_back(inInstance);
+}
+
+void RenderInstancer::Queue(const glm::mat4 &inTransform, UInt8 r, UInt8 g, UInt8 b, UInt8 a) {
+    instances.resize(instances.size() + 1);
+    InstanceData &instance = instances.back();
+    // glm matrices are column major
+    instance.row0 = glm::vec4(inTransform[0][0], inTransform[1][0], inTransform[2][0], inTransform[3][0]);
+    instance.row1 = glm::vec4(inTransform[0][1], inTransform[1][1], inTransform[2][1], inTransform[3][1]);
+    instance.row2 = glm::vec4(inTransform[0][2], inTransform[1][2], inTransform[2][2], inTransform[3][2]);
+    instance.r = r;
+    instance.g = g;
+    instance.b = b;
+    instance.a = a;
+}
+
+void RenderInstancer::Clear() {
+    instances.clear();
+}
+
+void RenderInstancer::Upload() {
+    nUploaded = UInt32(instances.size());
+    if(instances.empty()) return;
+    if(hardware) {
+        StreamBuffer(instanceVboId, instanceBufferSize, &instances[0], instances.size()*sizeof(InstanceData));
+    } else {
+        Expand();
+        if(!expanded.empty()) StreamBuffer(expandedVboId, expandedBufferSize, &expanded[0], expanded.size()*sizeof(Vertex));
+    }
+}
+
+void RenderInstancer::Expand() {
+    UInt32 perInstance = nMeshIndices ? nMeshIndices : nMeshVertices;
+    expanded.resize(UInt(perInstance)*instances.size());
+
+    Vertex *out = expanded.empty() ? 0 : &expanded[0];
+    for(auto it = instances.begin(); it != instances.end(); ++it) {
+        const InstanceData &instance = *it;
+        for(UInt32 i = 0; i < perInstance; ++i) {
+            UInt32 index = i;
+            if(meshIndexSize == 2) index = ((const UInt16*)meshIndices)[i];
+            else if(meshIndexSize == 4) index = ((const UInt32*)meshIndices)[i];
+
+            const Vertex &v = meshVertices[index];
+            glm::vec4 position(v.x, v.y, v.z, 1.0f);
+            out->x = glm::dot(instance.row0, position);
+            out->y = glm::dot(instance.row1, position);
+            out->z = glm::dot(instance.row2, position);
+            out->r = UInt8((UInt32(v.r)*instance.r + 127)/255);
+            out->g = UInt8((UInt32(v.g)*instance.g + 127)/255);
+            out->b = UInt8((UInt32(v.b)*instance.b + 127)/255);
+            out->a = UInt8((UInt32(v.a)*instance.a + 127)/255);
+            out++;
+        }
+    }
+}
+
+void RenderInstancer::SetIdentityInstance(void *inUserData, const Shader &inShader) {
+    Int32 row0 = inShader.GetAttributeLocation("in_InstanceRow0");
+    Int32 row1 = inShader.GetAttributeLocation("in_InstanceRow1");
+    Int32 row2 = inShader.GetAttributeLocation("in_InstanceRow2");
+    Int32 color = inShader.GetAttributeLocation("in_InstanceColor");
+    if(row0 >= 0) glVertexAttrib4f(row0, 1.0f, 0.0f, 0.0f, 0.0f);
+    if(row1 >= 0) glVertexAttrib4f(row1, 0.0f, 1.0f, 0.0f, 0.0f);
+    if(row2 >= 0) glVertexAttrib4f(row2, 0.0f, 0.0f, 1.0f, 0.0f);
+    if(color >= 0) glVertexAttrib4f(color, 1.0f, 1.0f, 1.0f, 1.0f);
+}
+
+void RenderInstancer::DrawInstanced(UInt32 inIndexSize, Int32 inFirst, Int32 inCount, Int32 inNumInstances) {
+#ifndef __arm__
+    if(inIndexSize) {
+        const void *offset = (const void*)(UInt(inFirst)*inIndexSize);
+        if(GLEW_VERSION_3_1) glDrawElementsInstanced(GL_TRIANGLES, inCount, RenderBatcher::GetIndexType(inIndexSize), offset, inNumInstances);
+        else glDrawElementsInstancedARB(GL_TRIANGLES, inCount, RenderBatcher::GetIndexType(inIndexSize), offset, inNumInstances);
+    } else {
+        if(GLEW_VERSION_3_1) glDrawArraysInstanced(GL_TRIANGLES, inFirst, inCount, inNumInstances);
+        else glDrawArraysInstancedARB(GL_TRIANGLES, inFirst, inCount, inNumInstances);
+    }
+#endif
+}
+
+void RenderInstancer::Draw() {
+    if(!shader || !nUploaded || !nMeshVertices) return;
+    RenderState::UseProgram(shader->progId);
+
+    if(hardware) {
+        RenderVaoCache::Bind(*shader, meshVboId, GetVertexLayout<Vertex>(), nMeshIndices ? meshIboId : 0, instanceVboId, &GetVertexLayout<InstanceData>());
+        DrawInstanced(meshIndexSize, 0, Int32(nMeshIndices ? nMeshIndices : nMeshVertices), Int32(nUploaded));
+    } else {
+        RenderVaoCache::Bind(*shader, expandedVboId, GetVertexLayout<Vertex>());
+        SetIdentityInstance(0, *shader);
+        glDrawArrays(GL_TRIANGLES, 0, Int32(expanded.size()));
+    }
+}
+
+void RenderInstancer::UploadDraw(bool clear) {
+    Upload();
+    Draw();
+    if(clear) Clear();
+}
+
+void RenderInstancer::Submit(RenderDrawList &ioList, UInt32 inLayer, float inDepth, Shader::BlendFunc inBlend) const {
+    if(!shader || !nUploaded || !nMeshVertices) return;
+
+    if(hardware) {
+        ioList.SubmitInstanced(inLayer, inDepth, *shader, inBlend, meshVboId, GetVertexLayout<Vertex>(), meshIboId, meshIndexSize,
+                               0, Int32(nMeshIndices ? nMeshIndices : nMeshVertices), instanceVboId, GetVertexLayout<InstanceData>(), Int32(nUploaded));
+    } else {
+        ioList.Submit(inLayer, inDepth, *shader, inBlend, expandedVboId, GetVertexLayout<Vertex>(), 0, Int32(expanded.size()), &SetIdentityInstance, 0);
+    }
+}
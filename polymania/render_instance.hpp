@@ -0,0 +1,73 @@
+#pragma once
+
+#define DEFAULT_INSTANCES_PER_BATCH 1024
+
+// one drawn copy of a RenderInstancer's mesh
+struct InstanceData {
+    glm::vec4 row0, row1, row2; // top three rows of the affine object to world transform
+    UInt8 r,g,b,a; // multiplies the mesh colors
+};
+
+DECLARE_VERTEX_LAYOUT(InstanceData);
+
+/*
+ * Draws one mesh many times with a record per copy. With instanced arrays (GL 3.3 or ARB_instanced_arrays)
+ * the records are streamed into a buffer read once per instance by glDraw*Instanced, the mesh is uploaded
+ * once. Otherwise (GLES2) every frame's instances are expanded into world space vertices on the CPU.
+ *
+ * The shader reads in_InstanceRow0..2 and in_InstanceColor next to the mesh attributes,
+ * shaders/instanced.glv is one
+ */
+class RenderInstancer {
+public:
+    RenderInstancer(UInt32 inInstancesPerBatch=DEFAULT_INSTANCES_PER_BATCH);
+    ~RenderInstancer();
+
+    static bool IsHardwareSupported();
+    bool IsHardware() const { return hardware; }
+
+    void SetShader(const Shader &inShader);
+    // inVertices and inIndices (null for a triangle list) have to stay valid while the mesh is set, the
+    // fallback reads them every frame, e.g. keep the ResourceMesh handle
+    void SetMesh(const Vertex *inVertices, UInt32 inNumVertices, const void *inIndices=0, UInt32 inNumIndices=0, UInt32 inIndexSize=0);
+
+    void Queue(const InstanceData &inInstance);
+    void Queue(const glm::mat4 &inTransform, UInt8 r=255, UInt8 g=255, UInt8 b=255, UInt8 a=255);
+    void Clear();
+    // streams the queued instances, or expands them into vertices without instancing
+    void Upload();
+    // attaches the shader and draws every uploaded instance
+    void Draw();
+    void UploadDraw(bool hintClear=true);
+    void Submit(RenderDrawList &ioList, UInt32 inLayer, float inDepth, Shader::BlendFunc inBlend) const;
+
+    UInt32 GetNumInstances() const { return UInt32(instances.size()); }
+
+    // glDrawArraysInstanced or glDrawElementsInstanced for inIndexSize 0 or 2/4 with inFirst counted in vertices or indices
+    static void DrawInstanced(UInt32 inIndexSize, Int32 inFirst, Int32 inCount, Int32 inNumInstances);
+
+private:
+    // the fallback's instance attributes are constants, the identity transform and white
+    static void SetIdentityInstance(void *inUserData, const Shader &inShader);
+    void Expand();
+
+private:
+    const Shader *shader;
+    bool hardware;
+
+    const Vertex *meshVertices;
+    UInt32 nMeshVertices;
+    const void *meshIndices;
+    UInt32 nMeshIndices;
+    UInt32 meshIndexSize;
+    UInt32 meshVboId, meshIboId;
+
+    std::vector<InstanceData> instances;
+    UInt32 instanceVboId;
+    UInt instanceBufferSize;
+    UInt32 nUploaded; // instances in the buffer, or expanded into it
+
+    std::vector<Vertex> expanded; // the fallback's world space vertices
+    UInt32 expandedVboId;
+    UInt expandedBufferSize;
+};
@@ -0,0 +1,230 @@
+#ifdef __arm__
+#include <GLES2/gl2.h>
+#include <EGL/egl.h>
+#define GLFW_INCLUDE_ES2
+#else
+#include <GL/glew.h>
+#endif
+
+#include <glm/glm.hpp>
+
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <list>
+#include <atomic>
+#include <mutex>
+#include <memory>
+
+#include "types.hpp"
+#include "asyncmodel.hpp"
+#include "resource.hpp"
+#include "vertex_layout.hpp"
+#include "shader.hpp"
+#include "render_list.hpp"
+#include "render_instance.hpp"
+#include "render_state.hpp"
+#include "render_vao.hpp"
+
+RenderDrawList::RenderDrawList(UInt32 inReserveCommands) {
+    commands.reserve(inReserveCommands);
+    entries.reserve(inReserveCommands);
+    scratch.reserve(inReserveCommands);
+}
+
+RenderDrawList::~RenderDrawList() {
+}
+
+UInt64 RenderDrawList::MakeKey(UInt32 inLayer, float inDepth, UInt32 inShaderId, Shader::BlendFunc inBlend, UInt32 inBufferId) {
+    // the bits of a positive float order like the float, the top 24 are plenty to sort by
+    UInt32 depthBits = 0;
+    if(inDepth > 0.0f) std::memcpy(&depthBits, &inDepth, sizeof(depthBits));
+    UInt64 depth = depthBits >> (31 - KEY_DepthBits);
+    UInt64 shaderId = inShaderId & ((1 << KEY_ShaderBits) - 1);
+    UInt64 bufferId = inBufferId & ((1 << KEY_BufferBits) - 1);
+
+    UInt64 key = UInt64(inLayer & ((1 << KEY_LayerBits) - 1)) << (64 - KEY_LayerBits);
+    key |= UInt64(inBlend) << (64 - KEY_LayerBits - KEY_BlendBits);
+    if(inBlend == Shader::BLEND_None) {
+        // state first, depth only orders draws that share it
+        key |= shaderId << (KEY_BufferBits + KEY_DepthBits);
+        key |= bufferId << KEY_DepthBits;
+        key |= depth;
+    } else {
+        // blending needs back to front whatever it costs in state changes
+        key |= (((1 << KEY_DepthBits) - 1) - depth) << (KEY_ShaderBits + KEY_BufferBits);
+        key |= shaderId << KEY_BufferBits;
+        key |= bufferId;
+    }
+    return key;
+}
+
+void RenderDrawList::Submit(UInt32 inLayer, float inDepth, const Shader &inShader, Shader::BlendFunc inBlend, UInt32 inBufferId, const VertexLayout &inLayout,
+                            Int32 inFirst, Int32 inCount, DrawCallback inCallback, void *inUserData) {
+    Command c;
+    c.shader = &inShader;
+    c.bufferId = inBufferId;
+    c.layout = &inLayout;
+    c.indexBufferId = 0;
+    c.indexSize = 0;
+    c.first = inFirst;
+    c.count = inCount;
+    c.blend = inBlend;
+    c.instanceBufferId = 0;
+    c.instanceLayout = 0;
+    c.numInstances = 0;
+    c.callback = inCallback;
+    c.userData = inUserData;
+    Add(inLayer, inDepth, c);
+}
+
+void RenderDrawList::SubmitIndexed(UInt32 inLayer, float inDepth, const Shader &inShader, Shader::BlendFunc inBlend, UInt32 inBufferId, const VertexLayout &inLayout,
+                                   UInt32 inIndexBufferId, UInt32 inIndexSize, Int32 inFirst, Int32 inCount, DrawCallback inCallback, void *inUserData) {
+    Command c;
+    c.shader = &inShader;
+    c.bufferId = inBufferId;
+    c.layout = &inLayout;
+    c.indexBufferId = inIndexBufferId;
+    c.indexSize = inIndexSize;
+    c.first = inFirst;
+    c.count = inCount;
+    c.blend = inBlend;
+    c.instanceBufferId = 0;
+    c.instanceLayout = 0;
+    c.numInstances = 0;
+    c.callback = inCallback;
+    c.userData = inUserData;
+    Add(inLayer, inDepth, c);
+}
+
+void RenderDrawList::SubmitInstanced(UInt32 inLayer, float inDepth, const Shader &inShader, Shader::BlendFunc inBlend, UInt32 inBufferId, const VertexLayout &inLayout,
+                                     UInt32 inIndexBufferId, UInt32 inIndexSize, Int32 inFirst, Int32 inCount,
+                                     UInt32 inInstanceBufferId, const VertexLayout &inInstanceLayout, Int32 inNumInstances, DrawCallback inCallback, void *inUserData) {
+    if(inNumInstances <= 0) return;
+
+    Command c;
+    c.shader = &inShader;
+    c.bufferId = inBufferId;
+    c.layout = &inLayout;
+    c.indexBufferId = inIndexBufferId;
+    c.indexSize = inIndexSize;
+    c.first = inFirst;
+    c.count = inCount;
+    c.blend = inBlend;
+    c.instanceBufferId = inInstanceBufferId;
+    c.instanceLayout = &inInstanceLayout;
+    c.numInstances = inNumInstances;
+    c.callback = inCallback;
+    c.userData = inUserData;
+    Add(inLayer, inDepth, c);
+}
+
+void RenderDrawList::Add(UInt32 inLayer, float inDepth, const Command &inCommand) {
+    if(inCommand.count <= 0) return;
+
+    // GL names are small integers, truncated ones that collide only cost extra state changes
+    SortEntry e;
+    e.key = MakeKey(inLayer, inDepth, inCommand.shader->progId, inCommand.blend, inCommand.bufferId);
+    e.command = UInt32(commands.size());
+
+    commands.push_back(inCommand);
+    entries.push_back(e);
+}
+
+void RenderDrawList::Clear() {
+    commands.clear();
+    entries.clear();
+}
+
+void RenderDrawList::Sort() {
+    // least significant digit first, 8 bits per pass, all histograms gathered in one sweep
+    const UInt32 numPasses = 8;
+    UInt32 counts[numPasses][256];
+    std::memset(counts, 0, sizeof(counts));
+    for(auto it = entries.begin(); it != entries.end(); ++it) {
+        UInt64 key = it->key;
+        for(UInt32 pass = 0; pass < numPasses; ++pass) {
+            counts[pass][(key >> (pass*8)) & 0xFF]++;
+        }
+    }
+
+    scratch.resize(entries.size());
+    SortEntry *src = &entries[0], *dst = &scratch[0];
+    UInt32 n = UInt32(entries.size());
+    for(UInt32 pass = 0; pass < numPasses; ++pass) {
+        UInt32 *count = counts[pass];
+        UInt32 shift = pass*8;
+        // a digit every key shares leaves the order as it is
+        if(count[(src[0].key >> shift) & 0xFF] == n) continue;
+
+        UInt32 offsets[256];
+        UInt32 sum = 0;
+        for(UInt32 i = 0; i < 256; ++i) {
+            offsets[i] = sum;
+            sum += count[i];
+        }
+        for(UInt32 i = 0; i < n; ++i) {
+            dst[offsets[(src[i].key >> shift) & 0xFF]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+
+    if(src != &entries[0]) entries.swap(scratch);
+}
+
+void RenderDrawList::Execute(bool clear) {
+    stats = RenderDrawStats();
+    if(entries.empty()) return;
+    Sort();
+
+    const Shader *shader = 0;
+    UInt32 progId = 0;
+    UInt32 bufferId = 0;
+    const VertexLayout *layout = 0;
+    UInt32 instanceBufferId = 0;
+    const VertexLayout *instanceLayout = 0;
+    UInt32 indexBufferId = 0;
+    Int32 blend = -1;
+    for(auto it = entries.begin(); it != entries.end(); ++it) {
+        const Command &c = commands[it->command];
+
+        bool shaderChanged = c.shader != shader || c.shader->progId != progId;
+        if(shaderChanged) {
+            shader = c.shader;
+            progId = shader->progId;
+            RenderState::UseProgram(progId);
+            stats.shaderChanges++;
+        }
+        // attribute locations belong to the program, so a new one needs its own vertex array as well
+        UInt32 commandIndexBufferId = c.indexSize ? c.indexBufferId : 0;
+        if(shaderChanged || c.bufferId != bufferId || c.layout != layout || c.instanceBufferId != instanceBufferId || c.instanceLayout != instanceLayout ||
+           commandIndexBufferId != indexBufferId) {
+            if(c.bufferId != bufferId) stats.bufferChanges++;
+            bufferId = c.bufferId;
+            layout = c.layout;
+            instanceBufferId = c.instanceBufferId;
+            instanceLayout = c.instanceLayout;
+            indexBufferId = commandIndexBufferId;
+            RenderVaoCache::Bind(*shader, bufferId, *layout, indexBufferId, instanceBufferId, instanceLayout);
+        }
+        if(Int32(c.blend) != blend) {
+            blend = c.blend;
+            Shader::SetBlendFunc(c.blend);
+            stats.blendChanges++;
+        }
+
+        if(c.callback) c.callback(c.userData, *shader);
+        if(c.instanceLayout) {
+            RenderInstancer::DrawInstanced(c.indexSize, c.first, c.count, c.numInstances);
+        } else if(c.indexSize) {
+            glDrawElements(GL_TRIANGLES, c.count, RenderBatcher::GetIndexType(c.indexSize), (const void*)(UInt(c.first)*c.indexSize));
+        } else {
+            glDrawArrays(GL_TRIANGLES, c.first, c.count);
+        }
+        stats.draws++;
+    }
+
+    if(clear) Clear();
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#define DEFAULT_DRAW_LIST_COMMANDS 1024
+
+struct RenderDrawStats {
+    UInt32 draws;
+    UInt32 shaderChanges;
+    UInt32 bufferChanges;
+    UInt32 blendChanges;
+
+    RenderDrawStats() : draws(0), shaderChanges(0), bufferChanges(0), blendChanges(0) {}
+};
+
+/*
+ * Draws submitted during a frame, each with a 64 bit sort key. Execute radix sorts the keys
+ * and walks them in order, only touching the program, buffer and blend state when the next
+ * draw needs something different. Within a layer opaque draws come first, grouped by shader
+ * and buffer and front to back, then blended draws back to front
+ */
+class RenderDrawList {
+public:
+    // called right before the draw with its shader attached, e.g. for per object uniforms
+    typedef void (*DrawCallback)(void *inUserData, const Shader &inShader);
+
+    enum {
+        KEY_LayerBits = 8,
+        KEY_BlendBits = 2,
+        KEY_DepthBits = 24,
+        KEY_ShaderBits = 12,
+        KEY_BufferBits = 16
+    };
+
+public:
+    RenderDrawList(UInt32 inReserveCommands=DEFAULT_DRAW_LIST_COMMANDS);
+    ~RenderDrawList();
+
+    // inFirst and inCount are vertices laid out as inLayout in inBufferId, inDepth is the distance from the camera
+    void Submit(UInt32 inLayer, float inDepth, const Shader &inShader, Shader::BlendFunc inBlend, UInt32 inBufferId, const VertexLayout &inLayout,
+                Int32 inFirst, Int32 inCount, DrawCallback inCallback=0, void *inUserData=0);
+    // inFirst and inCount are indices of inIndexSize (2 or 4) bytes in inIndexBufferId
+    void SubmitIndexed(UInt32 inLayer, float inDepth, const Shader &inShader, Shader::BlendFunc inBlend, UInt32 inBufferId, const VertexLayout &inLayout,
+                       UInt32 inIndexBufferId, UInt32 inIndexSize, Int32 inFirst, Int32 inCount, DrawCallback inCallback=0, void *inUserData=0);
+    // draws inNumInstances copies, reading inInstanceLayout's attributes once per instance from inInstanceBufferId,
+    // inIndexSize is 0 to draw vertices instead of indices
+    void SubmitInstanced(UInt32 inLayer, float inDepth, const Shader &inShader, Shader::BlendFunc inBlend, UInt32 inBufferId, const VertexLayout &inLayout,
+                         UInt32 inIndexBufferId, UInt32 inIndexSize, Int32 inFirst, Int32 inCount,
+                         UInt32 inInstanceBufferId, const VertexLayout &inInstanceLayout, Int32 inNumInstances, DrawCallback inCallback=0, void *inUserData=0);
+    void Clear();
+    // sorts and draws everything submitted, the state it leaves behind is that of the last draw
+    void Execute(bool hintClear=true);
+
+    UInt32 GetSize() const { return UInt32(commands.size()); }
+    // of the last Execute
+    const RenderDrawStats &GetStats() const { return stats; }
+
+    static UInt64 MakeKey(UInt32 inLayer, float inDepth, UInt32 inShaderId, Shader::BlendFunc inBlend, UInt32 inBufferId);
+
+private:
+    struct Command {
+        const Shader *shader;
+        UInt32 bufferId;
+        const VertexLayout *layout;
+        UInt32 indexBufferId;
+        UInt32 indexSize; // 0 for glDrawArrays
+        Int32 first, count;
+        UInt32 instanceBufferId;
+        const VertexLayout *instanceLayout; // null unless instanced
+        Int32 numInstances;
+        Shader::BlendFunc blend;
+        DrawCallback callback;
+        void *userData;
+    };
+
+    struct SortEntry {
+        UInt64 key;
+        UInt32 command;
+    };
+
+    void Add(UInt32 inLayer, float inDepth, const Command &inCommand);
+    void Sort();
+
+private:
+    std::vector<Command> commands;
+    std::vector<SortEntry> entries;
+    std::vector<SortEntry> scratch; // other half of the radix sort ping-pong
+    RenderDrawStats stats;
+};
@@ -0,0 +1,223 @@
+#ifdef __arm__
+#include <GLES2/gl2.h>
+#include <EGL/egl.h>
+#define GLFW_INCLUDE_ES2
+#else
+#include <GL/glew.h>
+#endif
+
+#include "types.hpp"
+#include "render_state.hpp"
+#include "render_vao.hpp"
+
+static const UInt32 UNKNOWN = ~0u;
+
+enum BufferSlot {
+    SLOT_Array,
+    SLOT_ElementArray,
+#ifndef __arm__
+    SLOT_CopyRead,
+    SLOT_CopyWrite,
+#endif
+    NUM_SLOTS
+};
+
+struct CachedState {
+    UInt32 program;
+    UInt32 buffers[NUM_SLOTS];
+    UInt32 vertexArray;
+    UInt32 attribKnown, attribEnabled; // one bit per location
+    UInt32 blend, blendSrc, blendDst;
+    UInt32 depthTest, depthWrite, depthFunc;
+    UInt32 culling, cullFace, frontFace;
+    Int32 viewport[4];
+    bool viewportKnown;
+
+    CachedState() { Reset(); }
+
+    void Reset() {
+        program = UNKNOWN;
+        for(UInt32 i = 0; i < NUM_SLOTS; ++i) buffers[i] = UNKNOWN;
+        vertexArray = UNKNOWN;
+        attribKnown = 0;
+        attribEnabled = 0;
+        blend = blendSrc = blendDst = UNKNOWN;
+        depthTest = depthWrite = depthFunc = UNKNOWN;
+        culling = cullFace = frontFace = UNKNOWN;
+        viewportKnown = false;
+    }
+};
+
+static CachedState state;
+static RenderStateStats stats;
+
+// true when inValue differs from ioCached, which then holds it
+static inline bool Change(UInt32 &ioCached, UInt32 inValue) {
+    if(ioCached == inValue) {
+        stats.skipped++;
+        return false;
+    }
+    ioCached = inValue;
+    stats.issued++;
+    return true;
+}
+
+static inline void SetCapability(UInt32 &ioCached, GLenum inCapability, bool inEnabled) {
+    if(!Change(ioCached, inEnabled ? 1 : 0)) return;
+    if(inEnabled) glEnable(inCapability);
+    else glDisable(inCapability);
+}
+
+static Int32 GetBufferSlot(UInt32 inTarget) {
+    switch(inTarget) {
+        case GL_ARRAY_BUFFER:
+            return SLOT_Array;
+        case GL_ELEMENT_ARRAY_BUFFER:
+            return SLOT_ElementArray;
+#ifndef __arm__
+        case GL_COPY_READ_BUFFER:
+            return SLOT_CopyRead;
+        case GL_COPY_WRITE_BUFFER:
+            return SLOT_CopyWrite;
+#endif
+        default:
+            return -1;
+    }
+}
+
+void RenderState::UseProgram(UInt32 inProgId) {
+    if(Change(state.program, inProgId)) glUseProgram(inProgId);
+}
+
+void RenderState::BindBuffer(UInt32 inTarget, UInt32 inBufferId) {
+    Int32 slot = GetBufferSlot(inTarget);
+    if(slot < 0) {
+        stats.issued++;
+        glBindBuffer(inTarget, inBufferId);
+    } else if(Change(state.buffers[slot], inBufferId)) {
+        glBindBuffer(inTarget, inBufferId);
+    }
+}
+
+void RenderState::BindVertexArray(UInt32 inVaoId) {
+#ifndef __arm__
+    if(!Change(state.vertexArray, inVaoId)) return;
+    glBindVertexArray(inVaoId);
+    state.buffers[SLOT_ElementArray] = UNKNOWN;
+    state.attribKnown = 0;
+#endif
+}
+
+void RenderState::BindVertexArray(UInt32 inVaoId, UInt32 inIndexBufferId) {
+#ifndef __arm__
+    if(!Change(state.vertexArray, inVaoId)) return;
+    glBindVertexArray(inVaoId);
+    state.buffers[SLOT_ElementArray] = inIndexBufferId;
+    state.attribKnown = 0;
+#endif
+}
+
+void RenderState::SetVertexAttribArray(UInt32 inLocation, bool inEnabled) {
+    if(inLocation < RENDER_STATE_TRACKED_ATTRIBUTES) {
+        UInt32 bit = 1u << inLocation;
+        if((state.attribKnown & bit) && ((state.attribEnabled & bit) != 0) == inEnabled) {
+            stats.skipped++;
+            return;
+        }
+        state.attribKnown |= bit;
+        if(inEnabled) state.attribEnabled |= bit;
+        else state.attribEnabled &= ~bit;
+    }
+    stats.issued++;
+    if(inEnabled) glEnableVertexAttribArray(inLocation);
+    else glDisableVertexAttribArray(inLocation);
+}
+
+void RenderState::SetBlend(bool inEnabled) {
+    SetCapability(state.blend, GL_BLEND, inEnabled);
+}
+
+void RenderState::SetBlendFunc(UInt32 inSrcFactor, UInt32 inDstFactor) {
+    if(state.blendSrc == inSrcFactor && state.blendDst == inDstFactor) {
+        stats.skipped++;
+        return;
+    }
+    state.blendSrc = inSrcFactor;
+    state.blendDst = inDstFactor;
+    stats.issued++;
+    glBlendFunc(inSrcFactor, inDstFactor);
+}
+
+void RenderState::SetDepthTest(bool inEnabled) {
+    SetCapability(state.depthTest, GL_DEPTH_TEST, inEnabled);
+}
+
+void RenderState::SetDepthWrite(bool inEnabled) {
+    if(Change(state.depthWrite, inEnabled ? 1 : 0)) glDepthMask(inEnabled ? GL_TRUE : GL_FALSE);
+}
+
+void RenderState::SetDepthFunc(UInt32 inFunc) {
+    if(Change(state.depthFunc, inFunc)) glDepthFunc(inFunc);
+}
+
+void RenderState::SetCulling(bool inEnabled) {
+    SetCapability(state.culling, GL_CULL_FACE, inEnabled);
+}
+
+void RenderState::SetCullFace(UInt32 inFace) {
+    if(Change(state.cullFace, inFace)) glCullFace(inFace);
+}
+
+void RenderState::SetFrontFace(UInt32 inWinding) {
+    if(Change(state.frontFace, inWinding)) glFrontFace(inWinding);
+}
+
+void RenderState::SetViewport(Int32 inX, Int32 inY, Int32 inWidth, Int32 inHeight) {
+    Int32 *v = state.viewport;
+    if(state.viewportKnown && v[0] == inX && v[1] == inY && v[2] == inWidth && v[3] == inHeight) {
+        stats.skipped++;
+        return;
+    }
+    v[0] = inX;
+    v[1] = inY;
+    v[2] = inWidth;
+    v[3] = inHeight;
+    state.viewportKnown = true;
+    stats.issued++;
+    glViewport(inX, inY, inWidth, inHeight);
+}
+
+void RenderState::DeleteBuffer(UInt32 inBufferId) {
+    if(!inBufferId) return;
+    // a vertex array pointing at it would keep the old storage alive under a name GL may hand out again
+    RenderVaoCache::ForgetBuffer(inBufferId);
+    glDeleteBuffers(1, &inBufferId);
+    for(UInt32 i = 0; i < NUM_SLOTS; ++i) {
+        if(state.buffers[i] == inBufferId) state.buffers[i] = 0;
+    }
+}
+
+void RenderState::DeleteVertexArray(UInt32 inVaoId) {
+#ifndef __arm__
+    if(!inVaoId) return;
+    glDeleteVertexArrays(1, &inVaoId);
+    if(state.vertexArray == inVaoId) {
+        // back on the default vertex array, whose contents were not tracked
+        state.vertexArray = 0;
+        state.buffers[SLOT_ElementArray] = UNKNOWN;
+        state.attribKnown = 0;
+    }
+#endif
+}
+
+void RenderState::Invalidate() {
+    state.Reset();
+}
+
+const RenderStateStats &RenderState::GetStats() {
+    return stats;
+}
+
+void RenderState::ResetStats() {
+    stats = RenderStateStats();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#define RENDER_STATE_TRACKED_ATTRIBUTES 32 // attribute arrays with a cached enable, higher locations always reach GL
+
+struct RenderStateStats {
+    UInt32 issued; // calls that reached GL
+    UInt32 skipped; // calls dropped because GL already had the state
+
+    RenderStateStats() : issued(0), skipped(0) {}
+};
+
+/*
+ * The GL state the renderer changes, remembered so that setting what is already set costs no driver call.
+ * Programs, buffer and vertex array bindings, blending, depth, culling and the viewport all go through
+ * here; a GL call around it leaves the cache wrong until Invalidate. One GL context is assumed
+ */
+class RenderState {
+public:
+    static void UseProgram(UInt32 inProgId);
+    static void BindBuffer(UInt32 inTarget, UInt32 inBufferId);
+    // the element array buffer and the attribute arrays belong to the vertex array, they are
+    // forgotten when it changes
+    static void BindVertexArray(UInt32 inVaoId);
+    // one known to hold inIndexBufferId as its element array buffer
+    static void BindVertexArray(UInt32 inVaoId, UInt32 inIndexBufferId);
+    static void SetVertexAttribArray(UInt32 inLocation, bool inEnabled);
+
+    static void SetBlend(bool inEnabled);
+    static void SetBlendFunc(UInt32 inSrcFactor, UInt32 inDstFactor);
+    static void SetDepthTest(bool inEnabled);
+    static void SetDepthWrite(bool inEnabled);
+    static void SetDepthFunc(UInt32 inFunc);
+    static void SetCulling(bool inEnabled);
+    static void SetCullFace(UInt32 inFace);
+    static void SetFrontFace(UInt32 inWinding);
+    static void SetViewport(Int32 inX, Int32 inY, Int32 inWidth, Int32 inHeight);
+
+    // deleting a bound name unbinds it, so these go through here too
+    static void DeleteBuffer(UInt32 inBufferId);
+    static void DeleteVertexArray(UInt32 inVaoId);
+
+    // everything is unknown and the next call of each kind reaches GL, e.g. after a new context
+    static void Invalidate();
+
+    static const RenderStateStats &GetStats();
+    static void ResetStats();
+};
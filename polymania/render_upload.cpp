@@ -0,0 +1,203 @@
+#ifdef __arm__
+#include <GLES2/gl2.h>
+#include <EGL/egl.h>
+#define GLFW_INCLUDE_ES2
+#else
+#include <GL/glew.h>
+#endif
+
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <list>
+#include <atomic>
+#include <mutex>
+#include <memory>
+
+#include "types.hpp"
+#include "asyncmodel.hpp"
+#include "resource.hpp"
+#include "render_upload.hpp"
+#include "render_state.hpp"
+
+RenderUploadQueue::RenderUploadQueue(UInt inStagingBytes, UInt inBytesPerFrame)
+    : stagingId(0), stagingSize(inStagingBytes), stagingHead(0), stagingUsed(0), bytesPerFrame(inBytesPerFrame), nextTicket(1), bytesUploaded(0) {
+#ifndef __arm__
+    bool hasSync = GLEW_VERSION_3_2 || GLEW_ARB_sync;
+    bool hasCopy = GLEW_VERSION_3_1 || GLEW_ARB_copy_buffer;
+    bool hasMapRange = GLEW_VERSION_3_0 || GLEW_ARB_map_buffer_range;
+    if(hasSync && hasCopy && hasMapRange && stagingSize > 0) {
+        glGenBuffers(1, &stagingId);
+        RenderState::BindBuffer(GL_COPY_READ_BUFFER, stagingId);
+        glBufferData(GL_COPY_READ_BUFFER, stagingSize, 0, GL_STREAM_DRAW);
+    }
+#endif
+}
+
+RenderUploadQueue::~RenderUploadQueue() {
+#ifndef __arm__
+    for(auto it = inFlight.begin(); it != inFlight.end(); ++it) {
+        glDeleteSync((GLsync)it->fence);
+    }
+    RenderState::DeleteBuffer(stagingId);
+#endif
+}
+
+UInt32 RenderUploadQueue::Enqueue(UInt32 inBufferId, const void *inData, UInt inSizeBytes, UInt32 inUsage,
+                                  const ResourceHandle &inOwner, CompletionCallback inCallback, void *inUserData) {
+    // the new storage replaces whatever they were filling
+    for(auto it = pending.begin(); it != pending.end();) {
+        if((*it)->bufferId == inBufferId) {
+            (*it)->cancelled = true;
+            (*it)->owner.reset();
+            it = pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for(auto it = inFlight.begin(); it != inFlight.end(); ++it) {
+        if(it->request->bufferId == inBufferId) it->request->cancelled = true;
+    }
+
+    RequestPtr request = std::make_shared<Request>();
+    request->ticket = nextTicket++;
+    if(!nextTicket) nextTicket = 1;
+    request->bufferId = inBufferId;
+    request->data = (const UInt8*)inData;
+    request->sizeBytes = inSizeBytes;
+    request->submitted = 0;
+    request->chunksInFlight = 0;
+    request->cancelled = false;
+    request->owner = inOwner;
+    request->callback = inCallback;
+    request->userData = inUserData;
+
+#ifndef __arm__
+    if(stagingId) {
+        // the copy targets leave the GL_ARRAY_BUFFER binding the batchers rely on alone
+        RenderState::BindBuffer(GL_COPY_WRITE_BUFFER, inBufferId);
+        glBufferData(GL_COPY_WRITE_BUFFER, inSizeBytes, 0, inUsage);
+    } else
+#endif
+    {
+        // everything binding GL_ARRAY_BUFFER goes through RenderState, so there is nothing to restore
+        RenderState::BindBuffer(GL_ARRAY_BUFFER, inBufferId);
+        glBufferData(GL_ARRAY_BUFFER, inSizeBytes, 0, inUsage);
+    }
+
+    pending.push_back(request);
+    return request->ticket;
+}
+
+void RenderUploadQueue::Cancel(UInt32 inTicket) {
+    for(auto it = pending.begin(); it != pending.end(); ++it) {
+        if((*it)->ticket == inTicket) {
+            (*it)->cancelled = true;
+            (*it)->owner.reset();
+            pending.erase(it);
+            return;
+        }
+    }
+    // fully submitted, only the callback is left to suppress
+    for(auto it = inFlight.begin(); it != inFlight.end(); ++it) {
+        if(it->request->ticket == inTicket) it->request->cancelled = true;
+    }
+}
+
+void RenderUploadQueue::Update() {
+    RetireChunks();
+
+    UInt budget = bytesPerFrame;
+    while(!pending.empty() && budget > 0) {
+        RequestPtr request = pending.front();
+        UInt sent = stagingId ? SubmitStaged(request, budget) : SubmitDirect(*request, budget);
+        budget -= sent;
+        bytesUploaded += sent;
+        // out of budget or staging space, the rest goes next frame
+        if(request->submitted < request->sizeBytes) break;
+
+        pending.pop_front();
+        request->data = 0;
+        request->owner.reset();
+        if(!request->chunksInFlight) Complete(*request);
+    }
+}
+
+UInt RenderUploadQueue::SubmitStaged(const RequestPtr &inRequest, UInt inMaxBytes) {
+    UInt sent = 0;
+#ifndef __arm__
+    RenderState::BindBuffer(GL_COPY_READ_BUFFER, stagingId);
+    RenderState::BindBuffer(GL_COPY_WRITE_BUFFER, inRequest->bufferId);
+    while(sent < inMaxBytes && inRequest->submitted < inRequest->sizeBytes) {
+        // contiguous free space after the head, chunks are split at the end of the ring instead of skipping it
+        if(!stagingUsed) stagingHead = 0;
+        UInt tail = (stagingHead + stagingSize - stagingUsed) % stagingSize;
+        UInt contiguous = stagingUsed == stagingSize ? 0 : (tail > stagingHead ? tail - stagingHead : stagingSize - stagingHead);
+        UInt bytes = std::min(std::min(contiguous, inMaxBytes - sent), inRequest->sizeBytes - inRequest->submitted);
+        if(!bytes) break;
+
+        // the range is not used by any unsignalled copy, so nothing has to wait
+        void *staging = glMapBufferRange(GL_COPY_READ_BUFFER, stagingHead, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if(!staging) break;
+        std::memcpy(staging, inRequest->data + inRequest->submitted, bytes);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, stagingHead, inRequest->submitted, bytes);
+
+        Chunk chunk;
+        chunk.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        chunk.stagingBytes = bytes;
+        chunk.request = inRequest;
+        inFlight.push_back(chunk);
+        inRequest->chunksInFlight++;
+
+        stagingHead = (stagingHead + bytes) % stagingSize;
+        stagingUsed += bytes;
+        inRequest->submitted += bytes;
+        sent += bytes;
+    }
+#endif
+    return sent;
+}
+
+UInt RenderUploadQueue::SubmitDirect(Request &ioRequest, UInt inMaxBytes) {
+    UInt bytes = std::min(inMaxBytes, ioRequest.sizeBytes - ioRequest.submitted);
+    if(!bytes) return 0;
+
+    RenderState::BindBuffer(GL_ARRAY_BUFFER, ioRequest.bufferId);
+    glBufferSubData(GL_ARRAY_BUFFER, ioRequest.submitted, bytes, ioRequest.data + ioRequest.submitted);
+
+    ioRequest.submitted += bytes;
+    return bytes;
+}
+
+void RenderUploadQueue::RetireChunks() {
+#ifndef __arm__
+    while(!inFlight.empty()) {
+        Chunk &chunk = inFlight.front();
+        GLenum status = glClientWaitSync((GLsync)chunk.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if(status == GL_TIMEOUT_EXPIRED) break;
+        // signalled, or GL_WAIT_FAILED which would never change
+        glDeleteSync((GLsync)chunk.fence);
+        stagingUsed -= chunk.stagingBytes;
+
+        RequestPtr request = chunk.request;
+        inFlight.pop_front();
+        if(!--request->chunksInFlight && request->submitted == request->sizeBytes) Complete(*request);
+    }
+#endif
+}
+
+void RenderUploadQueue::Complete(Request &ioRequest) {
+    if(!ioRequest.cancelled && ioRequest.callback) ioRequest.callback(ioRequest.userData, ioRequest.ticket);
+}
+
+RenderUploadStats RenderUploadQueue::GetStats() const {
+    RenderUploadStats stats;
+    stats.bytesUploaded = bytesUploaded;
+    stats.pendingRequests = UInt32(pending.size());
+    stats.chunksInFlight = UInt32(inFlight.size());
+    stats.stagingUsed = stagingUsed;
+    return stats;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#define DEFAULT_UPLOAD_STAGING_BYTES (8*1024*1024)
+#define DEFAULT_UPLOAD_BYTES_PER_FRAME (2*1024*1024)
+
+struct RenderUploadStats {
+    UInt64 bytesUploaded;
+    UInt32 pendingRequests; // not yet fully submitted to GL
+    UInt32 chunksInFlight; // submitted, waiting for their fence
+    UInt stagingUsed;
+
+    RenderUploadStats() : bytesUploaded(0), pendingRequests(0), chunksInFlight(0), stagingUsed(0) {}
+};
+
+/*
+ * Moves CPU side buffers into GL buffer objects a bounded number of bytes per frame.
+ * With sync objects and buffer copies available the data goes through a ring of staging
+ * memory and a request completes once the fence behind its last chunk signals,
+ * otherwise (GLES2) it is written with glBufferSubData in budget sized pieces
+ */
+class RenderUploadQueue {
+public:
+    // called from Update on the GL thread once the whole buffer can be drawn
+    typedef void (*CompletionCallback)(void *inUserData, UInt32 inTicket);
+
+public:
+    RenderUploadQueue(UInt inStagingBytes=DEFAULT_UPLOAD_STAGING_BYTES, UInt inBytesPerFrame=DEFAULT_UPLOAD_BYTES_PER_FRAME);
+    ~RenderUploadQueue();
+
+    // (re)allocates inBufferId for inSizeBytes and queues filling it from inData, which has to stay valid
+    // until it is all copied, inOwner (e.g. the ResourceMesh handle) is held that long. Earlier requests
+    // for the same buffer are cancelled. Returns a ticket that is never 0
+    UInt32 Enqueue(UInt32 inBufferId, const void *inData, UInt inSizeBytes, UInt32 inUsage,
+                   const ResourceHandle &inOwner, CompletionCallback inCallback, void *inUserData);
+    // the callback will not be called, chunks already copied finish in the background
+    void Cancel(UInt32 inTicket);
+
+    // once per frame on the GL thread, retires signalled chunks then submits up to the byte budget
+    void Update();
+
+    void SetBytesPerFrame(UInt inBytesPerFrame) { bytesPerFrame = inBytesPerFrame; }
+    UInt GetBytesPerFrame() const { return bytesPerFrame; }
+    bool IsStaged() const { return stagingId != 0; }
+    RenderUploadStats GetStats() const;
+
+private:
+    struct Request {
+        UInt32 ticket;
+        UInt32 bufferId;
+        const UInt8 *data;
+        UInt sizeBytes;
+        UInt submitted; // bytes handed to GL so far
+        UInt32 chunksInFlight;
+        bool cancelled;
+        ResourceHandle owner;
+        CompletionCallback callback;
+        void *userData;
+    };
+    typedef std::shared_ptr<Request> RequestPtr;
+
+    struct Chunk {
+        void *fence; // GLsync
+        UInt stagingBytes;
+        RequestPtr request;
+    };
+
+    UInt SubmitStaged(const RequestPtr &inRequest, UInt inMaxBytes);
+    UInt SubmitDirect(Request &ioRequest, UInt inMaxBytes);
+    void RetireChunks();
+    void Complete(Request &ioRequest);
+
+private:
+    UInt32 stagingId; // 0 when uploads go straight through glBufferSubData
+    UInt stagingSize;
+    UInt stagingHead; // next byte written
+    UInt stagingUsed; // bytes between the oldest unsignalled chunk and stagingHead
+    UInt bytesPerFrame;
+    UInt32 nextTicket;
+    UInt64 bytesUploaded;
+
+    std::list<RequestPtr> pending; // in submission order, the front one is being copied
+    std::list<Chunk> inFlight; // oldest first
+};
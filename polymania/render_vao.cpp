@@ -0,0 +1,167 @@
+#ifdef __arm__
+#include <GLES2/gl2.h>
+#include <EGL/egl.h>
+#define GLFW_INCLUDE_ES2
+#else
+#include <GL/glew.h>
+#endif
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <list>
+#include <atomic>
+#include <mutex>
+#include <memory>
+
+#include "types.hpp"
+#include "asyncmodel.hpp"
+#include "resource.hpp"
+#include "vertex_layout.hpp"
+#include "shader.hpp"
+#include "render_state.hpp"
+#include "render_vao.hpp"
+
+struct VaoKey {
+    UInt32 progId;
+    UInt32 bufferId;
+    const VertexLayout *layout;
+    UInt32 indexBufferId;
+    UInt32 instanceBufferId;
+    const VertexLayout *instanceLayout;
+
+    bool operator==(const VaoKey &inOther) const {
+        return progId == inOther.progId && bufferId == inOther.bufferId && layout == inOther.layout && indexBufferId == inOther.indexBufferId &&
+               instanceBufferId == inOther.instanceBufferId && instanceLayout == inOther.instanceLayout;
+    }
+
+    bool Uses(UInt32 inBufferId) const {
+        return bufferId == inBufferId || indexBufferId == inBufferId || instanceBufferId == inBufferId;
+    }
+};
+
+struct VaoKeyHash {
+    size_t operator()(const VaoKey &inKey) const {
+        UInt hash = inKey.progId;
+        hash = hash*31 + inKey.bufferId;
+        hash = hash*31 + UInt(inKey.layout);
+        hash = hash*31 + inKey.indexBufferId;
+        hash = hash*31 + inKey.instanceBufferId;
+        hash = hash*31 + UInt(inKey.instanceLayout);
+        return size_t(hash);
+    }
+};
+
+typedef std::unordered_map<VaoKey, UInt32, VaoKeyHash> VaoMap;
+
+static VaoMap vaos;
+static VaoKey current; // what the attribute pointers are set up for
+static bool currentValid = false;
+static UInt32 defaultVaoId = 0;
+static RenderVaoStats stats;
+
+static void DeleteVaos(bool (*inMatches)(const VaoKey &inKey, UInt32 inId), UInt32 inId) {
+    if(currentValid && inMatches(current, inId)) currentValid = false;
+    for(auto it = vaos.begin(); it != vaos.end();) {
+        if(inMatches(it->first, inId)) {
+            RenderState::DeleteVertexArray(it->second);
+            it = vaos.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+static bool UsesBuffer(const VaoKey &inKey, UInt32 inBufferId) {
+    return inKey.Uses(inBufferId);
+}
+
+static bool UsesProgram(const VaoKey &inKey, UInt32 inProgId) {
+    return inKey.progId == inProgId;
+}
+
+bool RenderVaoCache::IsHardware() {
+#ifdef __arm__
+    return false;
+#else
+    static Int32 supported = -1;
+    if(supported < 0) supported = GLEW_VERSION_3_0 || GLEW_ARB_vertex_array_object ? 1 : 0;
+    return supported != 0;
+#endif
+}
+
+void RenderVaoCache::Bind(const Shader &inShader, UInt32 inBufferId, const VertexLayout &inLayout, UInt32 inIndexBufferId,
+                          UInt32 inInstanceBufferId, const VertexLayout *inInstanceLayout) {
+    VaoKey key;
+    key.progId = inShader.progId;
+    key.bufferId = inBufferId;
+    key.layout = &inLayout;
+    key.indexBufferId = inIndexBufferId;
+    key.instanceBufferId = inInstanceBufferId;
+    key.instanceLayout = inInstanceLayout;
+    if(currentValid && key == current) return;
+    current = key;
+    currentValid = true;
+    stats.binds++;
+
+    if(IsHardware()) {
+        auto it = vaos.find(key);
+        if(it != vaos.end()) {
+            RenderState::BindVertexArray(it->second, inIndexBufferId);
+            return;
+        }
+#ifndef __arm__
+        UInt32 vaoId = 0;
+        glGenVertexArrays(1, &vaoId);
+        RenderState::BindVertexArray(vaoId);
+        vaos[key] = vaoId;
+#endif
+    }
+
+    // a new vertex array, or without them the pointers of whatever was bound before
+    RenderBatcher::SetVertexPointers(inShader, inBufferId, inLayout, inInstanceBufferId, inInstanceLayout);
+    if(inIndexBufferId) RenderState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, inIndexBufferId);
+    stats.setups++;
+}
+
+void RenderVaoCache::BindDefault() {
+    currentValid = false;
+#ifndef __arm__
+    if(!IsHardware()) return;
+    if(!defaultVaoId) glGenVertexArrays(1, &defaultVaoId);
+    RenderState::BindVertexArray(defaultVaoId);
+#endif
+}
+
+void RenderVaoCache::ForgetBuffer(UInt32 inBufferId) {
+    DeleteVaos(&UsesBuffer, inBufferId);
+}
+
+void RenderVaoCache::ForgetProgram(UInt32 inProgId) {
+    DeleteVaos(&UsesProgram, inProgId);
+}
+
+void RenderVaoCache::Clear() {
+    for(auto it = vaos.begin(); it != vaos.end(); ++it) {
+        RenderState::DeleteVertexArray(it->second);
+    }
+    vaos.clear();
+    RenderState::DeleteVertexArray(defaultVaoId);
+    defaultVaoId = 0;
+    currentValid = false;
+}
+
+UInt32 RenderVaoCache::GetSize() {
+    return UInt32(vaos.size());
+}
+
+const RenderVaoStats &RenderVaoCache::GetStats() {
+    return stats;
+}
+
+void RenderVaoCache::ResetStats() {
+    stats = RenderVaoStats();
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+class Shader;
+struct VertexLayout;
+
+struct RenderVaoStats {
+    UInt32 binds; // switches between combinations
+    UInt32 setups; // attribute pointers specified, once per combination with vertex array objects, every switch without
+
+    RenderVaoStats() : binds(0), setups(0) {}
+};
+
+/*
+ * One vertex array object per combination of program, vertex buffer and layout, index buffer and
+ * instance buffer and layout, set up on first use so that switching between them is a single
+ * glBindVertexArray. Without vertex array objects (GLES2, GL 2.x) the combination last bound is
+ * remembered instead and the attribute pointers are only respecified when a different one is bound.
+ *
+ * Binding an index buffer changes the bound vertex array, so GL_ELEMENT_ARRAY_BUFFER uploads call
+ * BindDefault first. Deleted buffers and programs are forgotten through ForgetBuffer and ForgetProgram,
+ * RenderState::DeleteBuffer and Shader do that
+ */
+class RenderVaoCache {
+public:
+    static void Bind(const Shader &inShader, UInt32 inBufferId, const VertexLayout &inLayout, UInt32 inIndexBufferId=0,
+                     UInt32 inInstanceBufferId=0, const VertexLayout *inInstanceLayout=0);
+    // a vertex array of no cached combination, to bind index buffers or set pointers by hand without changing one
+    static void BindDefault();
+
+    static void ForgetBuffer(UInt32 inBufferId);
+    static void ForgetProgram(UInt32 inProgId);
+    // deletes every vertex array, e.g. before the context goes away
+    static void Clear();
+
+    static bool IsHardware();
+    static UInt32 GetSize();
+    static const RenderVaoStats &GetStats();
+    static void ResetStats();
+};
@@ -1,28 +1,78 @@
 #include <cstdlib> 
 #include <cstdio>
 #include <cctype>
+#include <cstring>
+#include <algorithm>
 #include <memory>
 #include <unordered_map>
+#include <list>
+#include <vector>
 #include <string>
 #include <iostream>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <limits>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #include "types.hpp"
 #include "asyncmodel.hpp"
 #include "resource.hpp"
+#include "resource_stream.hpp"
+#include "resource_watch.hpp"
+#include "resource_prefetch.hpp"
+#include "resource_dedup.hpp"
 
 using std::FILE;
 
+// alignment malloc already guarantees
+static const UInt32 MALLOC_ALIGNMENT = 2*sizeof(void*);
+
 class ResourceMemoryAllocatorDefault : public ResourceMemoryAllocator {
 public:
+#if defined(_WIN32)
     void *Allocate(UInt inSize, UInt32 inAlignment) {
-        return std::malloc(inSize);
+        return _aligned_malloc(inSize, std::max(inAlignment, MALLOC_ALIGNMENT));
     }
     void *Reallocate(void *inPtr, UInt inSize, UInt32 inAlignment) {
-        return std::realloc(inPtr, inSize);
+        return _aligned_realloc(inPtr, inSize, std::max(inAlignment, MALLOC_ALIGNMENT));
     }
     void Free(void *inPtr) {
-        return std::free(inPtr);
+        _aligned_free(inPtr);
+    }
+#else
+    void *Allocate(UInt inSize, UInt32 inAlignment) {
+        if(inAlignment <= MALLOC_ALIGNMENT) return std::malloc(inSize);
+
+        void *ptr;
+        return posix_memalign(&ptr, inAlignment, inSize) == 0 ? ptr : 0;
+    }
+    void *Reallocate(void *inPtr, UInt inSize, UInt32 inAlignment) {
+        void *ptr = std::realloc(inPtr, inSize);
+        if(!ptr || inAlignment <= MALLOC_ALIGNMENT || (UInt(ptr) & (inAlignment-1)) == 0) return ptr;
+
+        // realloc lost the alignment, the resized block holds inSize valid bytes to move over
+        void *aligned = Allocate(inSize, inAlignment);
+        if(aligned) std::memcpy(aligned, ptr, inSize);
+        std::free(ptr);
+        return aligned;
     }
+    void Free(void *inPtr) {
+        std::free(inPtr);
+    }
+#endif
 };
 
 static ResourceMemoryAllocator *GetDefaultAllocatorInstance() {
@@ -32,6 +82,25 @@ static ResourceMemoryAllocator *GetDefaultAllocatorInstance() {
 
 ResourceMemoryAllocator *ResourceMemoryAllocator::instance = GetDefaultAllocatorInstance();
 
+#if defined(_MSC_VER)
+static __declspec(thread) const ResourceMemoryTag *currentMemoryTag = 0;
+#else
+static __thread const ResourceMemoryTag *currentMemoryTag = 0;
+#endif
+
+ResourceMemoryTag::ResourceMemoryTag(const char *inCategory, const std::string *inLocation)
+    : category(inCategory), location(inLocation), previous(currentMemoryTag) {
+    currentMemoryTag = this;
+}
+
+ResourceMemoryTag::~ResourceMemoryTag() {
+    currentMemoryTag = previous;
+}
+
+const ResourceMemoryTag *ResourceMemoryTag::GetCurrent() {
+    return currentMemoryTag;
+}
+
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -51,8 +120,13 @@ class ResourceIoDisk : public ResourceIo {
     friend class ResourceDirectoryDisk;
 
 public:
-    ResourceIoDisk(FILE *fp, bool writable) : fp(fp), writable(writable) {
+    ResourceIoDisk(FILE *fp, bool writable) : fp(fp), writable(writable), mapping(0), mappingSize(0) {
 
+    }
+    ~ResourceIoDisk() {
+#ifdef __linux__
+        if(mapping) munmap(mapping, mappingSize);
+#endif
     }
 
     AsyncResult<Int> Read(void *outBuffer, UInt inSizeBytes) {
@@ -72,10 +146,10 @@ public:
                 succ = fseek(fp, inOffset, SEEK_SET);
                 break;
             case ORIGIN_Cur:
-                succ = fseek(fp, inOffset, SEEK_SET);
+                succ = fseek(fp, inOffset, SEEK_CUR);
                 break;
             case ORIGIN_End:
-                succ = fseek(fp, inOffset, SEEK_SET);
+                succ = fseek(fp, inOffset, SEEK_END);
                 break;
             default:
                 return false;
@@ -92,10 +166,28 @@ public:
     bool IsSeekable() const {
         return true;
     }
+#ifdef __linux__
+    const void *Map(UInt &outSizeBytes) {
+        // writes through fp would not show up in a private mapping
+        if(writable) return 0;
+        if(!mapping) {
+            struct stat st;
+            if(fstat(fileno(fp), &st) != 0 || st.st_size <= 0) return 0;
+            void *ptr = mmap(0, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+            if(ptr == MAP_FAILED) return 0;
+            mapping = ptr;
+            mappingSize = UInt(st.st_size);
+        }
+        outSizeBytes = mappingSize;
+        return mapping;
+    }
+#endif
 
 private:
     FILE *fp;
     bool writable;
+    void *mapping; // whole file, unmapped when the io is closed
+    UInt mappingSize;
 };
 
 class ResourceDirectoryDisk : public ResourceDirectory {
@@ -104,6 +196,32 @@ public:
         return true;
     }
 
+#ifdef __linux__
+    bool Readahead(const std::string &inLocation, UInt64 inOffset, UInt64 inSizeBytes) {
+        int fd = open(inLocation.c_str(), O_RDONLY);
+        if(fd < 0) return false;
+        // the kernel keeps reading after the descriptor is closed
+        bool hinted = posix_fadvise(fd, off_t(inOffset), off_t(inSizeBytes), POSIX_FADV_WILLNEED) == 0;
+        close(fd);
+        return hinted;
+    }
+#endif
+
+    bool Prefetch(const std::string &inLocation, UInt64 inOffset, UInt64 inSizeBytes) {
+        FILE *fp = std::fopen(inLocation.c_str(), "rb");
+        if(!fp) return false;
+
+        std::vector<char> buf(64*1024);
+        bool ok = fseek(fp, long(inOffset), SEEK_SET) == 0;
+        while(ok && inSizeBytes) {
+            size_t bytesRead = fread(&buf[0], 1, size_t(std::min<UInt64>(inSizeBytes, buf.size())), fp);
+            if(!bytesRead) break;
+            inSizeBytes -= bytesRead;
+        }
+        fclose(fp);
+        return ok;
+    }
+
 protected:
     ResourceIo *InternalOpen(const std::string &inLocation, Int32 inPermission) {
         const char *mode;
@@ -133,7 +251,7 @@ protected:
         FILE *fp = std::fopen(inLocation.c_str(), mode);
         if(fp) {
             void *resourceIoDiskRaw = ResourceMemoryAllocator::instance->Allocate(sizeof(ResourceIoDisk));
-            return new(resourceIoDiskRaw)ResourceIoDisk(fp, readonly);
+            return new(resourceIoDiskRaw)ResourceIoDisk(fp, !readonly);
         } else {
             return 0;
         }
@@ -149,9 +267,16 @@ protected:
 AsyncResult<std::shared_ptr<ResourceIo>> ResourceDirectory::Open(const std::string &inLocation, Int32 inPermission)  {
     AsyncResult<std::shared_ptr<ResourceIo>> result;
     ResourceIo *rio = InternalOpen(inLocation, inPermission);
-    result.syncResult = rio ? std::shared_ptr<ResourceIo>(InternalOpen(inLocation, inPermission), 
-                                                 CloseResourceOnDestroy(this, &ResourceDirectory::InternalClose)) : 
+    result.syncResult = rio ? std::shared_ptr<ResourceIo>(rio, CloseResourceOnDestroy(this, &ResourceDirectory::InternalClose)) : 
                            std::shared_ptr<ResourceIo>();
+
+    ResourceAccessTrace *activeTrace = trace;
+    if(activeTrace && result.syncResult) {
+        UInt32 record = activeTrace->Touch(inLocation);
+        if(record != ResourceAccessTrace::INVALID_RECORD) {
+            result.syncResult = std::make_shared<ResourceIoTraced>(result.syncResult, activeTrace, record);
+        }
+    }
     return result;
 }
 
@@ -164,6 +289,106 @@ ResourceDirectory *ResourceDirectory::instance = GetDefaultResourceDirectoryInst
 
 //////////////////////////////////////////////////////////////////////////
 
+bool ResourceBlob::Load(ResourceMemoryAllocator &inAllocator, ResourceDirectory &inDir) {
+    allocator = &inAllocator;
+
+    auto resIo = inDir.Open(GetLocation(), ResourceDirectory::PERMISSION_ReadOnly).GetResult();
+    if(!resIo) return false;
+
+    if(!(flags & BLOB_Terminated) || resIo->IsMapTerminated()) {
+        UInt mappedSize = 0;
+        const void *mapped = resIo->Map(mappedSize);
+        if(mapped) {
+            data = (const UInt8*)mapped;
+            size = mappedSize;
+            mapping = resIo;
+            if(OnLoaded()) return true;
+            Unload();
+            return false;
+        }
+    }
+
+    UInt bytes;
+    UInt8 *buffer = ReadAll(*resIo, bytes);
+    if(!buffer) return false;
+    UInt terminator = (flags & BLOB_Terminated) ? 1 : 0;
+    if(terminator) buffer[bytes] = 0;
+
+    blobStore = (flags & BLOB_Shared) ? ResourceBlobStore::instance : 0;
+    const UInt8 *shared = blobStore ? (const UInt8*)blobStore->Acquire(buffer, bytes + terminator) : 0;
+    if(shared) {
+        allocator->Free(buffer);
+        data = shared;
+    } else {
+        blobStore = 0;
+        data = buffer;
+    }
+    size = bytes;
+
+    if(OnLoaded()) return true;
+    Unload();
+    return false;
+}
+
+UInt8 *ResourceBlob::ReadAll(ResourceIo &inIo, UInt &outSizeBytes) {
+    UInt terminator = (flags & BLOB_Terminated) ? 1 : 0;
+
+    Int knownSize = -1;
+    if(inIo.IsSeekable() && inIo.Seek(0, ResourceIo::ORIGIN_End)) {
+        knownSize = inIo.Tell();
+        if(!inIo.Seek(0, ResourceIo::ORIGIN_Set)) knownSize = -1;
+    }
+
+    UInt capacity = knownSize >= 0 ? UInt(knownSize) : 4096;
+    UInt8 *buffer = (UInt8*)allocator->Allocate(std::max<UInt>(capacity + terminator, 1));
+    if(!buffer) return 0;
+
+    UInt used = 0;
+    for(;;) {
+        if(used == capacity) {
+            // anything appended since the size was queried is left for the next reload
+            if(knownSize >= 0) break;
+
+            // no size up front, growing geometrically keeps the copying linear
+            UInt8 *grown = (UInt8*)allocator->Reallocate(buffer, capacity*2 + terminator);
+            if(!grown) {
+                allocator->Free(buffer);
+                return 0;
+            }
+            buffer = grown;
+            capacity *= 2;
+        }
+        Int bytesRead = inIo.Read(buffer + used, capacity - used).GetResult();
+        if(bytesRead <= 0) break;
+        used += UInt(bytesRead);
+    }
+
+    if(used < capacity) {
+        UInt8 *shrunk = (UInt8*)allocator->Reallocate(buffer, std::max<UInt>(used + terminator, 1));
+        if(shrunk) buffer = shrunk;
+    }
+    outSizeBytes = used;
+    return buffer;
+}
+
+bool ResourceBlob::Unload() {
+    if(!data) return false;
+
+    if(mapping) {
+        mapping.reset();
+    } else if(blobStore) {
+        blobStore->Release(data);
+        blobStore = 0;
+    } else {
+        allocator->Free((void*)data);
+    }
+    data = 0;
+    size = 0;
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 
 struct DecRefOnDestroy {
     ResourceCache *owner;
@@ -174,85 +399,765 @@ struct DecRefOnDestroy {
     }
 };
 
-void ResourceCache::DecRef( Resource *res ) {
-    res->refCount--;
-    if(res->refCount == 0) {
-        auto it = linkedResources.find(res->location);
-        if(it != linkedResources.end()) {
-            unlinkedResources[it->first] = it->second;
-            linkedResources.erase(it);
+UInt64 ResourceId::Hash( const std::string &inLocation ) {
+    UInt64 hash = 14695981039346656037ULL;
+    for(auto it = inLocation.begin(); it != inLocation.end(); ++it) {
+        hash ^= UInt8(*it);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::atomic<UInt64> ResourceCache::useClock(0);
+
+ResourceCache::ResourceCache(const std::string &inTypeName, UInt32 inTypeSize, void(*inConstructor)(Resource*)) 
+    : typeName(inTypeName), typeSize(inTypeSize), constructor(inConstructor), allocator(ResourceMemoryAllocator::instance), memoryBudget(0), memoryUsage(0), memoryPeak(0), 
+      hits(0), misses(0), evictions(0), numLinked(0), numUnlinked(0) {
+}
+
+ResourceCache::~ResourceCache() {
+    Purge();
+    if(numLinked) {
+        // their handles outlive the cache, DecRef would touch freed memory so they are leaked on purpose
+        std::cerr << "ResourceCache " << typeName << ": " << numLinked << " resources still linked at shutdown" << std::endl;
+        for(UInt32 i = 0; i < NUM_SHARDS; ++i) {
+            for(auto it = shards[i].linkedResources.begin(); it != shards[i].linkedResources.end(); ++it) {
+                std::cerr << "    " << it->second->location << " refs=" << it->second->refCount << std::endl;
+            }
         }
     }
 }
 
+ResourceCache::Shard &ResourceCache::GetShard( UInt64 inId ) {
+    return shards[(inId ^ (inId >> 32)) % NUM_SHARDS];
+}
+
+void ResourceCache::DecRef( Resource *res ) {
+    // fast path, dropping a handle that is not the last one needs no lock
+    Int32 count = res->refCount;
+    while(count > 1) {
+        if(res->refCount.compare_exchange_weak(count, count-1)) return;
+    }
+
+    // the last reference is only ever dropped (and a resource relinked) under the shard lock,
+    // so an unlinked resource cannot be evicted while we still look at it
+    Shard &shard = GetShard(res->id);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if(--res->refCount > 0) return;
+
+        auto it = shard.linkedResources.find(res->id);
+        if(it == shard.linkedResources.end()) return;
+        Touch(res);
+        shard.unlinkedResources[it->first] = shard.unlinkedLru.insert(shard.unlinkedLru.end(), res);
+        shard.linkedResources.erase(it);
+        numLinked--;
+        numUnlinked++;
+    }
+    UInt budget = memoryBudget;
+    if(budget) Trim(budget, ~UInt32(0));
+}
+
 ResourceHandle ResourceCache::Load(const std::string &inLocation) {
+    ResourceHandle resident = LoadResident(inLocation);
+    if(resident) return resident;
+
+    // finally if not found, call Load() and then link it
+    // concurrent misses on the same location may both load, Link keeps the first one
+    misses++;
+    Resource *r = LoadDetached(inLocation);
+    if(r && !r->Finalize()) {
+        Discard(r);
+        r = 0;
+    }
+    return r ? Link(r) : ResourceHandle();
+}
+
+ResourceHandle ResourceCache::LoadResident(const std::string &inLocation) {
+    UInt64 id = ResourceId::Hash(inLocation);
+    Shard &shard = GetShard(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    ResourceHandle handle = LoadResidentLocked(shard, id, &inLocation);
+    if(handle) hits++;
+    return handle;
+}
+
+ResourceHandle ResourceCache::LoadResident(UInt64 inId) {
+    Shard &shard = GetShard(inId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    ResourceHandle handle = LoadResidentLocked(shard, inId, 0);
+    if(handle) hits++;
+    return handle;
+}
+
+ResourceHandle ResourceCache::LoadResidentLocked(Shard &shard, UInt64 inId, const std::string *inLocation) {
     // first check linkedResources
-    auto itLinked = linkedResources.find(inLocation);
-    if(itLinked != linkedResources.end()) {
+    auto itLinked = shard.linkedResources.find(inId);
+    if(itLinked != shard.linkedResources.end()) {
+        if(inLocation && itLinked->second->location != *inLocation) return ResourceHandle();
         itLinked->second->refCount++;
         return ResourceHandle(itLinked->second, DecRefOnDestroy(this));
     }
 
     // if not found, check unlinkedResources and then link it
-    auto itUnlinked = unlinkedResources.find(inLocation);
-    if(itUnlinked != unlinkedResources.end()) {
-        Resource *resource = itUnlinked->second;
-        itUnlinked->second->refCount++;
-        linkedResources[itUnlinked->first] = itUnlinked->second;
-        unlinkedResources.erase(itUnlinked);
+    auto itUnlinked = shard.unlinkedResources.find(inId);
+    if(itUnlinked != shard.unlinkedResources.end()) {
+        Resource *resource = *itUnlinked->second;
+        if(inLocation && resource->location != *inLocation) return ResourceHandle();
+        resource->refCount++;
+        Touch(resource);
+        shard.linkedResources[itUnlinked->first] = resource;
+        shard.unlinkedLru.erase(itUnlinked->second);
+        shard.unlinkedResources.erase(itUnlinked);
+        numUnlinked--;
+        numLinked++;
         return ResourceHandle(resource, DecRefOnDestroy(this));
     }
 
-    // finally if not found, call Load() and then link it
-    Resource *r = LoadRaw(inLocation);
-    return r ? ResourceHandle(r, DecRefOnDestroy(this)) : ResourceHandle();
+    return ResourceHandle();
 }
 
 bool ResourceCache::Reload(const ResourceHandle &inHandle) {
+    ResourceMemoryTag tag(typeName.c_str(), &inHandle->location);
     if(!inHandle->Unload()) return false;
-    return inHandle->Load(*ResourceMemoryAllocator::instance, *ResourceDirectory::instance);
+    bool loaded = inHandle->Load(*allocator, *ResourceDirectory::instance) && inHandle->Finalize();
+
+    UInt newSize = typeSize + inHandle->GetSizeBytes();
+    ChargeMemory(Int(newSize) - Int(inHandle->sizeBytes));
+    inHandle->sizeBytes = newSize;
+    return loaded;
 }
 
-Resource *ResourceCache::LoadRaw( const std::string & inLocation ) {
-    Resource *newRes = (Resource*)ResourceMemoryAllocator::instance->Allocate(typeSize);
+bool ResourceCache::Refresh( const std::string &inLocation, ResourceHandle &outHandle ) {
+    UInt64 id = ResourceId::Hash(inLocation);
+    Shard &shard = GetShard(id);
+    Resource *dropped = 0;
+    outHandle.reset();
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto itLinked = shard.linkedResources.find(id);
+        if(itLinked != shard.linkedResources.end()) {
+            outHandle = LoadResidentLocked(shard, id, &inLocation);
+            if(!outHandle) return false;
+        } else {
+            auto itUnlinked = shard.unlinkedResources.find(id);
+            if(itUnlinked == shard.unlinkedResources.end() || (*itUnlinked->second)->location != inLocation) return false;
+            dropped = *itUnlinked->second;
+            shard.unlinkedLru.erase(itUnlinked->second);
+            shard.unlinkedResources.erase(itUnlinked);
+            numUnlinked--;
+        }
+    }
+
+    if(dropped) {
+        // nobody uses it, the next Load reads the new file
+        dropped->Unload();
+        Destroy(dropped);
+    } else {
+        Reload(outHandle);
+    }
+    return true;
+}
+
+Resource *ResourceCache::LoadDetached( const std::string & inLocation ) const {
+    ResourceMemoryTag tag(typeName.c_str(), &inLocation);
+    Resource *newRes = (Resource*)allocator->Allocate(typeSize);
     constructor(newRes);
     newRes->location = inLocation;
-    if(newRes->Load(*ResourceMemoryAllocator::instance, *ResourceDirectory::instance)) {
-        newRes->refCount++;
-        linkedResources[inLocation] = newRes;
+    newRes->id = ResourceId::Hash(inLocation);
+    if(newRes->Load(*allocator, *ResourceDirectory::instance)) {
         return newRes;
     } else {
         newRes->~Resource();
-        ResourceMemoryAllocator::instance->Free(newRes);
+        allocator->Free(newRes);
         return 0;
     }
 }
 
+ResourceHandle ResourceCache::Adopt( Resource *inResource ) {
+    // a synchronous Load may have beaten the streamer to it
+    ResourceHandle resident = LoadResident(inResource->location);
+    if(resident) {
+        Discard(inResource);
+        return resident;
+    }
+
+    misses++;
+    if(!inResource->Finalize()) {
+        Discard(inResource);
+        return ResourceHandle();
+    }
+    return Link(inResource);
+}
+
+void ResourceCache::Discard( Resource *inResource ) const {
+    inResource->Unload();
+    inResource->~Resource();
+    allocator->Free(inResource);
+}
+
+ResourceHandle ResourceCache::Link( Resource *newRes ) {
+    Shard &shard = GetShard(newRes->id);
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    ResourceHandle resident = LoadResidentLocked(shard, newRes->id, &newRes->location);
+    if(resident) {
+        // lost a race against another thread loading the same location
+        lock.unlock();
+        Discard(newRes);
+        return resident;
+    }
+    if(shard.linkedResources.count(newRes->id) || shard.unlinkedResources.count(newRes->id)) {
+        lock.unlock();
+        std::cerr << "ResourceCache " << typeName << ": hash collision, cannot load " << newRes->location << std::endl;
+        Discard(newRes);
+        return ResourceHandle();
+    }
+
+    newRes->refCount++;
+    newRes->sizeBytes = typeSize + newRes->GetSizeBytes();
+    // once unlocked it may already be reloaded (and resized) by another thread
+    UInt chargedBytes = newRes->sizeBytes;
+    Touch(newRes);
+    shard.linkedResources[newRes->id] = newRes;
+    numLinked++;
+    lock.unlock();
+
+    ChargeMemory(Int(chargedBytes));
+    UInt budget = memoryBudget;
+    if(budget) Trim(budget, ~UInt32(0));
+    return ResourceHandle(newRes, DecRefOnDestroy(this));
+}
+
+void ResourceCache::Destroy( Resource *res ) {
+    ChargeMemory(-Int(res->sizeBytes));
+    res->~Resource();
+    allocator->Free(res);
+}
+
+void ResourceCache::ChargeMemory( Int inDeltaBytes ) {
+    UInt usage = memoryUsage += UInt(inDeltaBytes);
+    UInt peak = memoryPeak;
+    while(usage > peak && !memoryPeak.compare_exchange_weak(peak, usage)) {}
+}
+
+void ResourceCache::Touch( Resource *res ) {
+    res->lastUse = ++useClock;
+}
+
 void ResourceCache::Purge() {
-    for(auto it=unlinkedResources.begin();it!=unlinkedResources.end();++it) {
-        it->second->Unload();
+    for(UInt32 i = 0; i < NUM_SHARDS; ++i) {
+        LruList purged;
+        {
+            std::lock_guard<std::mutex> lock(shards[i].mutex);
+            purged.swap(shards[i].unlinkedLru);
+            shards[i].unlinkedResources.clear();
+            numUnlinked -= UInt32(purged.size());
+        }
+        for(auto it=purged.begin();it!=purged.end();++it) {
+            (*it)->Unload();
+        }
+        for(auto it=purged.begin();it!=purged.end();++it) {
+            Destroy(*it);
+        }
     }
-    for(auto it=unlinkedResources.begin();it!=unlinkedResources.end();++it) {
-        it->second->~Resource();
-        ResourceMemoryAllocator::instance->Free(it->second);
+}
+
+bool ResourceCache::SetAllocator( ResourceMemoryAllocator *inAllocator ) {
+    if(numLinked || numUnlinked) return false;
+    allocator = inAllocator;
+    return true;
+}
+
+bool ResourceCache::Reset() {
+    if(numLinked) return false;
+    Purge();
+    // the purge above only ran destructors and no-op frees on a linear allocator
+    allocator->Reset();
+    return true;
+}
+
+void ResourceCache::SetMemoryBudget( UInt inBudgetBytes ) {
+    memoryBudget = inBudgetBytes;
+    if(inBudgetBytes) Trim(inBudgetBytes, ~UInt32(0));
+}
+
+UInt32 ResourceCache::Trim( UInt inBudgetBytes, UInt32 inMaxEvictions ) {
+    UInt32 evicted = 0;
+    while(memoryUsage > inBudgetBytes && evicted < inMaxEvictions && EvictOldest()) {
+        evicted++;
     }
-    unlinkedResources.clear();
+    return evicted;
+}
+
+bool ResourceCache::EvictOldest() {
+    // the shard fronts are only approximately ordered by the time we lock the winner
+    Shard *oldest = 0;
+    UInt64 oldestUse = 0;
+    for(UInt32 i = 0; i < NUM_SHARDS; ++i) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        if(!shards[i].unlinkedLru.empty() && (!oldest || shards[i].unlinkedLru.front()->lastUse < oldestUse)) {
+            oldest = &shards[i];
+            oldestUse = shards[i].unlinkedLru.front()->lastUse;
+        }
+    }
+    if(!oldest) return false;
+
+    Resource *res;
+    {
+        std::lock_guard<std::mutex> lock(oldest->mutex);
+        if(oldest->unlinkedLru.empty()) return false;
+        res = oldest->unlinkedLru.front();
+        oldest->unlinkedLru.pop_front();
+        oldest->unlinkedResources.erase(res->id);
+        numUnlinked--;
+    }
+    evictions++;
+
+    res->Unload();
+    Destroy(res);
+    return true;
+}
+
+bool ResourceCache::GetOldestUnlinkedUse( UInt64 &outLastUse ) {
+    bool found = false;
+    for(UInt32 i = 0; i < NUM_SHARDS; ++i) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        if(!shards[i].unlinkedLru.empty() && (!found || shards[i].unlinkedLru.front()->lastUse < outLastUse)) {
+            outLastUse = shards[i].unlinkedLru.front()->lastUse;
+            found = true;
+        }
+    }
+    return found;
+}
+
+ResourceCacheStats ResourceCache::GetStats() const {
+    ResourceCacheStats s;
+    s.hits = hits;
+    s.misses = misses;
+    s.evictions = evictions;
+    s.memoryUsage = memoryUsage;
+    s.memoryPeak = memoryPeak;
+    s.numLinked = numLinked;
+    s.numUnlinked = numUnlinked;
+    return s;
 }
 
 void ResourceManager::AddResourceLoader(const std::string &in3CharExtName, UInt32 inTypeSize, void(*inConstructor)(Resource*)) {
-    caches[in3CharExtName] = std::make_shared<ResourceCache>(inTypeSize, inConstructor);
+    std::lock_guard<std::mutex> lock(cachesMutex);
+    if(caches.find(in3CharExtName) != caches.end()) {
+        std::cerr << "ResourceLoader already registered for: " << in3CharExtName << std::endl;
+        return;
+    }
+    caches[in3CharExtName] = std::make_shared<ResourceCache>(in3CharExtName, inTypeSize, inConstructor);
 }
 
-ResourceHandle ResourceManager::Load(const std::string &location) {
-    std::string ext = location.substr(location.find_last_of(".") + 1);
+ResourceManager::~ResourceManager() {
+    // stop the workers first, they may still be loading into our caches
+    streamer.reset();
+    for(auto it = finalizeQueue.begin(); it != finalizeQueue.end(); ++it) {
+        if((*it)->loaded) (*it)->cache->Discard((*it)->loaded);
+    }
+}
+
+static std::string GetExtension(const std::string &inLocation) {
+    std::string ext = inLocation.substr(inLocation.find_last_of(".") + 1);
     for(auto it = ext.begin(); it != ext.end(); ++it) {
         *it = std::tolower(*it);
     }
-    auto it = caches.find(ext);
-    if(it == caches.end()) {
+    return ext;
+}
+
+ResourceCache *ResourceManager::FindCache(const std::string &location) {
+    std::string ext = GetExtension(location);
+    ResourceCache *cache = FindCacheByType(ext);
+    if(!cache) {
         std::cerr << "Could not found ResourceLoader for: " << ext << std::endl;
-        return ResourceHandle();
+    }
+    return cache;
+}
+
+void ResourceManager::GetCaches(std::vector<ResourceCache*> &outCaches) {
+    std::lock_guard<std::mutex> lock(cachesMutex);
+    for(auto it = caches.begin(); it != caches.end(); ++it) {
+        outCaches.push_back(it->second.get());
+    }
+}
+
+ResourceHandle ResourceManager::Load(const std::string &location) {
+    ResourceCache *cache = FindCache(location);
+    if(!cache) return ResourceHandle();
+
+    ResourceHandle handle = cache->Load(location);
+    if(handle && watcher) watcher->Watch(location);
+    if(memoryBudget) Trim();
+    return handle;
+}
+
+ResourceId ResourceManager::MakeId( const std::string &inLocation ) {
+    ResourceId id;
+    ResourceCache *cache = FindCache(inLocation);
+    if(!cache) return id;
+
+    UInt64 hash = ResourceId::Hash(inLocation);
+    std::lock_guard<std::mutex> lock(idMutex);
+    auto it = idRegistry.find(hash);
+    if(it == idRegistry.end()) {
+        it = idRegistry.insert(std::make_pair(hash, inLocation)).first;
+    } else if(it->second != inLocation) {
+        std::cerr << "ResourceId collision between " << it->second << " and " << inLocation << std::endl;
+        return id;
+    }
+
+    id.id = hash;
+    id.cache = cache;
+    id.location = &it->second;
+    return id;
+}
+
+ResourceHandle ResourceManager::Load( const ResourceId &inId ) {
+    if(!inId.IsValid()) return ResourceHandle();
+    ResourceHandle handle = inId.cache->LoadResident(inId.id);
+    return handle ? handle : Load(*inId.location);
+}
+
+struct LoadManyNode {
+    ResourceRequest request;
+    std::vector<std::string> dependencies;
+    bool expanded; // dependencies have been requested
+    Int32 mark; // 0 unvisited, 1 on the sort stack, 2 emitted
+
+    LoadManyNode() : expanded(false), mark(0) {}
+};
+
+typedef std::unordered_map<std::string, LoadManyNode> LoadManyGraph;
+
+static void EmitLoadManyNode(LoadManyGraph &ioGraph, LoadManyGraph::iterator inNode, std::vector<ResourceHandle> &outResources) {
+    if(inNode->second.mark == 2) return;
+    if(inNode->second.mark == 1) {
+        std::cerr << "Resource dependency cycle through: " << inNode->first << std::endl;
+        return;
+    }
+
+    inNode->second.mark = 1;
+    const std::vector<std::string> &deps = inNode->second.dependencies;
+    for(auto it = deps.begin(); it != deps.end(); ++it) {
+        EmitLoadManyNode(ioGraph, ioGraph.find(*it), outResources);
+    }
+    inNode->second.mark = 2;
+
+    ResourceHandle res = inNode->second.request.GetResource();
+    if(res) outResources.push_back(res);
+}
+
+UInt32 ResourceManager::LoadMany( const std::vector<std::string> &inLocations, std::vector<ResourceHandle> &outResources, Int32 inPriority ) {
+    LoadManyGraph graph;
+    std::vector<std::string> discovered; // keeps the output stable across runs
+    for(auto it = inLocations.begin(); it != inLocations.end(); ++it) {
+        if(graph.find(*it) != graph.end()) continue;
+        graph[*it].request = Request(*it, inPriority);
+        discovered.push_back(*it);
+    }
+
+    for(;;) {
+        Update(std::numeric_limits<double>::max(), ~UInt(0));
+
+        // expand finished nodes, their dependencies join the same parallel wave
+        bool waiting = false;
+        for(UInt32 i = 0; i < discovered.size(); ++i) {
+            LoadManyNode &node = graph[discovered[i]];
+            if(node.expanded) continue;
+            if(!node.request.IsComplete()) {
+                waiting = true;
+                continue;
+            }
+
+            node.expanded = true;
+            ResourceHandle res = node.request.GetResource();
+            if(res) res->GetDependencies(node.dependencies);
+            for(auto it = node.dependencies.begin(); it != node.dependencies.end(); ++it) {
+                if(graph.find(*it) != graph.end()) continue;
+                graph[*it].request = Request(*it, inPriority);
+                discovered.push_back(*it);
+                waiting = true;
+            }
+        }
+        if(!waiting) break;
+
+        std::shared_ptr<ResourceStreamer> s;
+        {
+            std::lock_guard<std::mutex> lock(requestMutex);
+            s = streamer;
+        }
+        if(s) s->WaitCompleted();
+    }
+
+    UInt32 failed = 0;
+    for(auto it = discovered.begin(); it != discovered.end(); ++it) {
+        auto node = graph.find(*it);
+        if(node->second.request.GetStatus() != ResourceRequest::STATUS_Complete) failed++;
+        EmitLoadManyNode(graph, node, outResources);
+    }
+    return failed;
+}
+
+UInt32 ResourceManager::LoadManifest( const std::string &inManifestLocation, std::vector<ResourceHandle> &outResources, Int32 inPriority ) {
+    auto resIo = ResourceDirectory::instance->Open(inManifestLocation, ResourceDirectory::PERMISSION_ReadOnly).GetResult();
+    if(!resIo) {
+        std::cerr << "Could not open resource manifest: " << inManifestLocation << std::endl;
+        return 1;
+    }
+
+    std::string text;
+    char buf[1024];
+    Int bytesRead;
+    while((bytesRead = resIo->Read(buf, sizeof(buf)).GetResult()) > 0) {
+        text.append(buf, bytesRead);
+    }
+
+    std::vector<std::string> locations;
+    size_t lineStart = 0;
+    while(lineStart < text.size()) {
+        size_t lineEnd = text.find('\n', lineStart);
+        if(lineEnd == std::string::npos) lineEnd = text.size();
+        std::string line = text.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+
+        size_t comment = line.find('#');
+        if(comment != std::string::npos) line.erase(comment);
+        size_t first = line.find_first_not_of(" \t\r");
+        if(first == std::string::npos) continue;
+        locations.push_back(line.substr(first, line.find_last_not_of(" \t\r") - first + 1));
+    }
+    return LoadMany(locations, outResources, inPriority);
+}
+
+ResourceRequest ResourceManager::Request(const std::string &inLocation, Int32 inPriority) {
+    std::lock_guard<std::mutex> lock(requestMutex);
+    auto itFlight = inFlight.find(inLocation);
+    if(itFlight != inFlight.end()) {
+        ResourceRequest request(itFlight->second);
+        if(request.GetPriority() < inPriority) request.SetPriority(inPriority);
+        return request;
+    }
+
+    ResourceCache *cache = FindCache(inLocation);
+    auto state = std::make_shared<ResourceRequestState>(inLocation, cache, inPriority);
+    if(!cache) {
+        state->status = ResourceRequest::STATUS_Failed;
+        return ResourceRequest(state);
+    }
+
+    state->handle = cache->LoadResident(inLocation);
+    if(state->handle) {
+        state->status = ResourceRequest::STATUS_Complete;
+        return ResourceRequest(state);
+    }
+
+    if(!streamer) {
+        UInt32 numThreads = numStreamingThreads;
+        if(!numThreads) numThreads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+        streamer = std::make_shared<ResourceStreamer>(numThreads);
+    }
+    streamer->Enqueue(state);
+    inFlight[inLocation] = state;
+    return ResourceRequest(state);
+}
+
+UInt32 ResourceManager::Update(double inMaxSeconds, UInt inMaxBytes) {
+    ReloadChanged();
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+        if(!streamer) return 0;
+        streamer->PopCompleted(finalizeQueue);
+    }
+    if(finalizeQueue.empty()) return 0;
+
+    // most urgent last so it can be popped off the back
+    std::sort(finalizeQueue.begin(), finalizeQueue.end(), &ResourceStreamer::ComparePriority);
+
+    auto start = std::chrono::steady_clock::now();
+    UInt32 finalized = 0;
+    UInt bytes = 0;
+    while(!finalizeQueue.empty()) {
+        auto state = finalizeQueue.back();
+        finalizeQueue.pop_back();
+
+        if(state->loaded) {
+            Resource *res = state->loaded;
+            state->loaded = 0;
+            bytes += res->GetSizeBytes();
+            state->handle = state->cache->Adopt(res);
+            if(state->handle && watcher) watcher->Watch(state->location);
+        }
+        {
+            // published under the lock so Request never hands out a finished request as in flight
+            std::lock_guard<std::mutex> lock(requestMutex);
+            state->status = state->handle ? ResourceRequest::STATUS_Complete : ResourceRequest::STATUS_Failed;
+            inFlight.erase(state->location);
+        }
+        finalized++;
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if(elapsed >= inMaxSeconds || bytes >= inMaxBytes) break;
+    }
+
+    if(finalized && memoryBudget) Trim();
+    return finalized;
+}
+
+void ResourceManager::SetHotReload( double inDebounceSeconds ) {
+    if(inDebounceSeconds > 0.0) {
+        watcher = std::make_shared<ResourceWatcher>(inDebounceSeconds);
+    } else {
+        watcher.reset();
+    }
+}
+
+UInt32 ResourceManager::Subscribe( ReloadCallback inCallback, void *inUserData ) {
+    subscribers.push_back(std::make_pair(inCallback, inUserData));
+    return UInt32(subscribers.size() - 1);
+}
+
+void ResourceManager::Unsubscribe( UInt32 inSubscription ) {
+    if(inSubscription < subscribers.size()) subscribers[inSubscription].first = 0;
+}
+
+void ResourceManager::ReloadChanged() {
+    if(!watcher) return;
+    std::vector<std::string> changed;
+    watcher->Poll(changed);
+
+    for(auto it = changed.begin(); it != changed.end(); ++it) {
+        // editors touch plenty of files we never loaded (swap files, backups), those are ignored quietly
+        ResourceCache *cache = FindCacheByType(GetExtension(*it));
+        ResourceHandle handle;
+        if(!cache || !cache->Refresh(*it, handle)) continue;
+
+        std::cout << "Reloaded resource: " << *it << std::endl;
+        for(UInt32 i = 0; i < subscribers.size(); ++i) {
+            if(subscribers[i].first) subscribers[i].first(subscribers[i].second, *it, handle);
+        }
+    }
+}
+
+void ResourceManager::SetMemoryBudget( UInt inBudgetBytes ) {
+    memoryBudget = inBudgetBytes;
+    if(inBudgetBytes) Trim();
+}
+
+ResourceCache *ResourceManager::FindCacheByType( const std::string &in3CharExtName ) {
+    std::lock_guard<std::mutex> lock(cachesMutex);
+    auto it = caches.find(in3CharExtName);
+    return it == caches.end() ? 0 : it->second.get();
+}
+
+bool ResourceManager::SetMemoryBudget( const std::string &in3CharExtName, UInt inBudgetBytes ) {
+    ResourceCache *cache = FindCacheByType(in3CharExtName);
+    if(!cache) return false;
+    cache->SetMemoryBudget(inBudgetBytes);
+    return true;
+}
+
+bool ResourceManager::SetAllocator( const std::string &in3CharExtName, ResourceMemoryAllocator *inAllocator ) {
+    ResourceCache *cache = FindCacheByType(in3CharExtName);
+    return cache ? cache->SetAllocator(inAllocator) : false;
+}
+
+bool ResourceManager::ResetCache( const std::string &in3CharExtName ) {
+    ResourceCache *cache = FindCacheByType(in3CharExtName);
+    return cache ? cache->Reset() : false;
+}
+
+UInt ResourceManager::GetMemoryUsage() {
+    std::vector<ResourceCache*> all;
+    GetCaches(all);
+    UInt usage = 0;
+    for(auto it = all.begin(); it != all.end(); ++it) {
+        usage += (*it)->GetMemoryUsage();
+    }
+    return usage;
+}
+
+UInt32 ResourceManager::Trim( UInt32 inMaxEvictions ) {
+    UInt budget = memoryBudget;
+    if(!budget) return 0;
+
+    std::vector<ResourceCache*> all;
+    GetCaches(all);
+
+    UInt32 evicted = 0;
+    while(GetMemoryUsage() > budget && evicted < inMaxEvictions) {
+        // pick the cache holding the least recently used unlinked resource
+        ResourceCache *oldest = 0;
+        UInt64 oldestUse = 0;
+        for(auto it = all.begin(); it != all.end(); ++it) {
+            UInt64 lastUse;
+            if((*it)->GetOldestUnlinkedUse(lastUse) && (!oldest || lastUse < oldestUse)) {
+                oldest = *it;
+                oldestUse = lastUse;
+            }
+        }
+        if(!oldest || !oldest->EvictOldest()) break;
+        evicted++;
+    }
+    return evicted;
+}
+
+void ResourceManager::PrintStats() {
+    std::vector<std::pair<std::string, ResourceCache*>> all;
+    {
+        std::lock_guard<std::mutex> lock(cachesMutex);
+        for(auto it = caches.begin(); it != caches.end(); ++it) {
+            all.push_back(std::make_pair(it->first, it->second.get()));
+        }
+    }
+
+    std::cout << "Resource caches: " << std::endl;
+    for(auto it = all.begin(); it != all.end(); ++it) {
+        const ResourceCacheStats s = it->second->GetStats();
+        std::cout << 
+            it->first << ": "
+            "hits=" << s.hits << " "
+            "misses=" << s.misses << " "
+            "evictions=" << s.evictions << " "
+            "linked=" << s.numLinked << " "
+            "unlinked=" << s.numUnlinked << " "
+            "memory=" << s.memoryUsage << " "
+            "peak=" << s.memoryPeak << " "
+            "budget=" << it->second->GetMemoryBudget() << std::endl;
+    }
+    std::cout << "total=" << GetMemoryUsage() << " budget=" << memoryBudget << std::endl;
+    std::cout << std::endl;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+bool ResourceRequest::IsComplete() const {
+    Int32 status = GetStatus();
+    return status == STATUS_Complete || status == STATUS_Failed;
+}
+
+Int32 ResourceRequest::GetStatus() const {
+    return state ? Int32(state->status) : Int32(STATUS_Failed);
+}
+
+const std::string &ResourceRequest::GetLocation() const {
+    return state->location;
+}
+
+Int32 ResourceRequest::GetPriority() const {
+    return state ? Int32(state->priority) : 0;
+}
+
+void ResourceRequest::SetPriority(Int32 inPriority) {
+    if(!state) return;
+    if(state->streamer) {
+        state->streamer->SetPriority(*state, inPriority);
     } else {
-        return ResourceHandle(it->second->Load(location));
+        state->priority = inPriority;
     }
 }
+
+ResourceHandle ResourceRequest::GetResource() const {
+    return state && state->status == STATUS_Complete ? state->handle : ResourceHandle();
+}
@@ -17,6 +17,31 @@ public:
     virtual void *Allocate(UInt inSizeBytes, UInt32 inAlignment)=0;
     virtual void *Reallocate(void *inPtr, UInt inSize, UInt32 inAlignment)=0;
     virtual void Free(void *inPtr)=0;
+
+    // release every allocation at once, returns false if unsupported
+    virtual bool Reset() { return false; }
+};
+
+// names what the allocations made on this thread are for while it is in scope, tags nest
+class ResourceMemoryTag {
+public:
+    ResourceMemoryTag(const char *inCategory, const std::string *inLocation=0);
+    ~ResourceMemoryTag();
+
+    const char *GetCategory() const { return category; }
+    const std::string *GetLocation() const { return location; } // may be null
+
+    // innermost tag of the calling thread, null if none
+    static const ResourceMemoryTag *GetCurrent();
+
+private:
+    ResourceMemoryTag(const ResourceMemoryTag&);
+    ResourceMemoryTag &operator=(const ResourceMemoryTag&);
+
+private:
+    const char *category;
+    const std::string *location;
+    const ResourceMemoryTag *previous;
 };
 
 class ResourceIo {
@@ -40,6 +65,11 @@ public:
     virtual bool IsWritable() const=0;
     virtual bool IsSeekable() const=0;
 
+    // the whole contents without copying, valid while the io is open, null if unsupported
+    virtual const void *Map(UInt &outSizeBytes) { return 0; }
+    // true if a 0 byte is known to follow what Map returns, so text can be used in place
+    virtual bool IsMapTerminated() const { return false; }
+
     template<typename T>
     inline T Read() {
         T val = T();
@@ -52,6 +82,9 @@ public:
     }
 };
 
+class ResourceAccessTrace;
+class ResourceBlobStore;
+
 class ResourceDirectory {
 public:
     static ResourceDirectory *instance;
@@ -63,59 +96,259 @@ public:
     };
 
 public:
-    ResourceDirectory() {}
+    ResourceDirectory() : trace(0) {}
     virtual ~ResourceDirectory() {}
 
     AsyncResult<std::shared_ptr<ResourceIo>> Open(const std::string &inLocation, Int32 inPermission);
     virtual bool IsWritable() const=0;
 
+    // every Open and read is recorded to inTrace while set, null stops tracing
+    void SetAccessTrace(ResourceAccessTrace *inTrace) { trace = inTrace; }
+
+    // ask the OS to start reading a range into its cache and return right away, false if unsupported
+    virtual bool Readahead(const std::string &inLocation, UInt64 inOffset, UInt64 inSizeBytes) { return false; }
+    // read a range through the OS cache and throw the data away, not traced
+    virtual bool Prefetch(const std::string &inLocation, UInt64 inOffset, UInt64 inSizeBytes) { return false; }
+
 protected:
     virtual ResourceIo *InternalOpen(const std::string &inLocation, Int32 inPermission)=0;
     virtual void InternalClose(ResourceIo *res)=0;
+
+private:
+    std::atomic<ResourceAccessTrace*> trace;
 };
 
 class Resource {
 public:
-    Resource() : refCount(0) {}
+    Resource() : refCount(0), sizeBytes(0), lastUse(0), id(0) {}
     virtual ~Resource() {}
 
     // all Resource types must return a default resource if not found
     virtual bool Load(ResourceMemoryAllocator &inAllocator, ResourceDirectory &inDir)=0;
     virtual bool Unload()=0;
 
+    // main thread part of loading (e.g. GPU uploads), called after a successful Load
+    virtual bool Finalize() { return true; }
+
+    // bytes allocated by Load, not counting the Resource object itself
+    virtual UInt GetSizeBytes() const { return 0; }
+
+    // locations this resource needs loaded before it can be used, known once Load succeeded
+    virtual void GetDependencies(std::vector<std::string> &outLocations) const {}
+
     const std::string &GetLocation() const { return location; }
 
 private:
-    Int32 refCount;
+    std::atomic<Int32> refCount; // number of live handles, reaching 0 only under the shard lock
+    UInt sizeBytes; // footprint charged to the owning cache
+    UInt64 lastUse; // ResourceCache::useClock when last linked or unlinked, guarded by the shard lock
+    UInt64 id; // ResourceId::Hash of the location, the key in the owning cache
     std::string location;
     friend class ResourceCache;
 };
 
 typedef std::shared_ptr<Resource> ResourceHandle;
 
+/*
+ * Base for resources that are the raw contents of their file, the size is queried up front
+ * so loading takes one allocation and one read, or no copy at all when a mapping can be borrowed
+ */
+class ResourceBlob : public Resource {
+public:
+    enum EFlags {
+        BLOB_Terminated = 1, // a 0 byte follows the data so text can be used in place, only mappings the io reports as terminated are borrowed
+        BLOB_Shared = 2 // identical contents under other locations share one copy through ResourceBlobStore
+    };
+
+public:
+    ResourceBlob(UInt32 inFlags=0) : data(0), size(0), flags(inFlags), allocator(0), blobStore(0) {}
+    bool Load(ResourceMemoryAllocator &inAllocator, ResourceDirectory &inDir);
+    bool Unload();
+    UInt GetSizeBytes() const { return data ? size + ((flags & BLOB_Terminated) ? 1 : 0) : 0; }
+
+    const UInt8 *GetData() const { return data; }
+    UInt GetSize() const { return size; }
+
+protected:
+    // lets derived formats look at the data once it arrived, false fails the load
+    virtual bool OnLoaded() { return true; }
+
+protected:
+    const UInt8 *data;
+    UInt size;
+
+private:
+    UInt8 *ReadAll(ResourceIo &inIo, UInt &outSizeBytes);
+
+private:
+    UInt32 flags;
+    ResourceMemoryAllocator *allocator;
+    ResourceBlobStore *blobStore; // set when data is shared through the store
+    std::shared_ptr<ResourceIo> mapping; // set when data is a borrowed mapping
+};
+
 template<typename T>
 struct ResourceHandleTyped {
     typedef std::shared_ptr<T> type;
 };
 
+struct ResourceCacheStats {
+    UInt64 hits;
+    UInt64 misses;
+    UInt64 evictions;
+    UInt memoryUsage; // linked + unlinked bytes
+    UInt memoryPeak;
+    UInt32 numLinked;
+    UInt32 numUnlinked;
+
+    ResourceCacheStats() : hits(0), misses(0), evictions(0), memoryUsage(0), memoryPeak(0), numLinked(0), numUnlinked(0) {}
+};
+
+/*
+ * Thread safe cache of one resource type, resources are sharded by location
+ */
 class ResourceCache {
 public:
-    ResourceCache(UInt32 inTypeSize, void(*inConstructor)(Resource*)) : typeSize(inTypeSize), constructor(inConstructor) {}
+    ResourceCache(const std::string &inTypeName, UInt32 inTypeSize, void(*inConstructor)(Resource*));
+    ~ResourceCache(); // purges, resources still linked are reported and leaked
 
     ResourceHandle Load(const std::string &inLocation);
-    bool Reload(const ResourceHandle &inHandle);
+    ResourceHandle LoadResident(const std::string &inLocation); // returns null unless already loaded
+    ResourceHandle LoadResident(UInt64 inId); // same keyed by ResourceId::Hash, without comparing locations
+    bool Reload(const ResourceHandle &inHandle); // main thread only, Finalize runs again
+    // the file behind inLocation changed: linked resources are reloaded in place and returned in outHandle,
+    // unlinked ones are simply dropped, returns false if the location is not resident at all
+    bool Refresh(const std::string &inLocation, ResourceHandle &outHandle);
     void Purge(); // Unload all unlinked resources
     void DecRef(Resource *inResource);
 
+    // only possible while the cache is empty, resources and their data come from this allocator
+    bool SetAllocator(ResourceMemoryAllocator *inAllocator);
+    ResourceMemoryAllocator *GetAllocator() const { return allocator; }
+    // purge everything and release the allocator in one go, fails while resources are linked
+    bool Reset();
+
+    // 0 means unlimited, only unlinked resources are ever evicted
+    void SetMemoryBudget(UInt inBudgetBytes);
+    UInt GetMemoryBudget() const { return memoryBudget; }
+
+    // evict least recently used unlinked resources until usage fits inBudgetBytes
+    UInt32 Trim(UInt inBudgetBytes, UInt32 inMaxEvictions);
+    bool EvictOldest();
+    // returns false if there is nothing to evict
+    bool GetOldestUnlinkedUse(UInt64 &outLastUse);
+
+    ResourceCacheStats GetStats() const;
+    UInt GetMemoryUsage() const { return memoryUsage; }
+
+    // split loading used by the streamer: LoadDetached may run on any thread,
+    // Adopt finalizes and links the result on the calling thread
+    Resource *LoadDetached(const std::string &inLocation) const;
+    ResourceHandle Adopt(Resource *inResource);
+    void Discard(Resource *inResource) const;
+
+private:
+    typedef std::list<Resource*> LruList;
+
+    struct Shard {
+        std::mutex mutex;
+        // maps resource id -> resource
+        std::unordered_map<UInt64, Resource*> linkedResources; // resources that are currently in use
+        std::unordered_map<UInt64, LruList::iterator> unlinkedResources; // resources that are currently not in use
+        LruList unlinkedLru; // least recently used at the front
+    };
+
+    enum { NUM_SHARDS = 16 };
+
+private:
+    Shard &GetShard(UInt64 inId);
+    // inLocation guards against hash collisions, null when the id is already known to be unique
+    ResourceHandle LoadResidentLocked(Shard &inShard, UInt64 inId, const std::string *inLocation);
+    ResourceHandle Link(Resource *inResource);
+    void Destroy(Resource *inResource);
+    void ChargeMemory(Int inDeltaBytes);
+    static void Touch(Resource *inResource);
+
+private:
+    Shard shards[NUM_SHARDS];
+    const std::string typeName; // 3 char extension, also the memory tag category
+    const UInt32 typeSize;
+    void(* const constructor)(Resource*);
+    ResourceMemoryAllocator *allocator;
+    std::atomic<UInt> memoryBudget;
+    std::atomic<UInt> memoryUsage;
+    std::atomic<UInt> memoryPeak;
+    std::atomic<UInt64> hits;
+    std::atomic<UInt64> misses;
+    std::atomic<UInt64> evictions;
+    std::atomic<UInt32> numLinked;
+    std::atomic<UInt32> numUnlinked;
+
+    static std::atomic<UInt64> useClock;
+};
+
+// location and cache resolved once, see ResourceManager::MakeId
+class ResourceId {
+public:
+    ResourceId() : id(0), cache(0), location(0) {}
+
+    bool IsValid() const { return cache ? true : false; }
+    UInt64 GetHash() const { return id; }
+    const std::string &GetLocation() const { return *location; }
+
+    bool operator==(const ResourceId &inOther) const { return id == inOther.id && cache == inOther.cache; }
+    bool operator!=(const ResourceId &inOther) const { return !(*this == inOther); }
+
+    // 64 bit FNV-1a of the location
+    static UInt64 Hash(const std::string &inLocation);
+
+private:
+    UInt64 id;
+    ResourceCache *cache;
+    const std::string *location; // owned by the manager's id registry
+    friend class ResourceManager;
+};
+
+struct ResourceRequestState;
+class ResourceStreamer;
+class ResourceWatcher;
+
+// handle to a streamed resource, returned immediately by ResourceManager::Request
+class ResourceRequest {
+public:
+    enum EStatus {
+        STATUS_Queued,
+        STATUS_Loading,
+        STATUS_Loaded, // waiting to be finalized on the main thread
+        STATUS_Complete,
+        STATUS_Failed
+    };
+
+public:
+    ResourceRequest() {}
+
+    bool IsValid() const { return state ? true : false; }
+    bool IsComplete() const; // complete or failed
+    Int32 GetStatus() const;
+    const std::string &GetLocation() const;
+
+    // higher priorities are loaded and finalized first
+    Int32 GetPriority() const;
+    void SetPriority(Int32 inPriority);
+
+    // null until the request is complete
+    ResourceHandle GetResource() const;
+    template<typename T>
+    typename ResourceHandleTyped<T>::type GetResource() const {
+        return std::static_pointer_cast<T>(GetResource());
+    }
+
 private:
-    Resource *LoadRaw( const std::string & inLocation );
+    ResourceRequest(const std::shared_ptr<ResourceRequestState> &inState) : state(inState) {}
 
 private:
-    // maps resource location -> resource
-    std::unordered_map<std::string, Resource*> linkedResources; // resources that are currently in use
-    std::unordered_map<std::string, Resource*> unlinkedResources; // resources that are currently not in use
-    UInt32 typeSize;
-    void(*constructor)(Resource*);
+    std::shared_ptr<ResourceRequestState> state;
+    friend class ResourceManager;
 };
 
 class ResourceManager {
@@ -128,6 +361,13 @@ private:
     };
 
 public:
+    // inResource is null if the changed resource was not linked and has just been dropped from its cache
+    typedef void (*ReloadCallback)(void *inUserData, const std::string &inLocation, const ResourceHandle &inResource);
+
+public:
+    ResourceManager() : memoryBudget(0), numStreamingThreads(0) {}
+    ~ResourceManager();
+
     template<typename T>
     void AddResourceLoader(const std::string &in3CharExtName) {
         AddResourceLoader(in3CharExtName, sizeof(T), &CtorToFunc<T>::Ctor);
@@ -140,7 +380,72 @@ public:
     }
     ResourceHandle Load(const std::string &location);
 
-    // resource type (3 char extension name) -> cache
+    // resolve a location once, the returned id is invalid if its hash collides with another location
+    ResourceId MakeId(const std::string &inLocation);
+    // a resident resource costs one integer lookup, anything else falls back to Load(location)
+    template<typename T>
+    typename ResourceHandleTyped<T>::type Load(const ResourceId &inId) {
+        return std::static_pointer_cast<T>(Load(inId));
+    }
+    ResourceHandle Load(const ResourceId &inId);
+
+    // loads inLocations and everything they depend on in parallel on the streaming threads,
+    // outResources receives them in dependency order (dependencies first), returns the number of failed loads
+    UInt32 LoadMany(const std::vector<std::string> &inLocations, std::vector<ResourceHandle> &outResources, Int32 inPriority=0);
+    // same as LoadMany with a text file listing one location per line, # starts a comment
+    UInt32 LoadManifest(const std::string &inManifestLocation, std::vector<ResourceHandle> &outResources, Int32 inPriority=0);
+
+    // queue a background load, the returned request completes during a later Update
+    ResourceRequest Request(const std::string &inLocation, Int32 inPriority=0);
+    // finalize completed requests on the main thread, stops once either budget is used up
+    UInt32 Update(double inMaxSeconds, UInt inMaxBytes);
+    // must be called before the first Request, 0 picks one less than the number of cores
+    void SetStreamingThreads(UInt32 inNumThreads) { numStreamingThreads = inNumThreads; }
+
+    // watch the directories of loaded resources and reload changed files during Update,
+    // must be called before the first Load, 0 disables it
+    void SetHotReload(double inDebounceSeconds);
+    // subscribers are told about every reloaded location so they can rebuild what depends on it
+    UInt32 Subscribe(ReloadCallback inCallback, void *inUserData);
+    void Unsubscribe(UInt32 inSubscription);
+
+    // global budget across all caches, 0 means unlimited
+    void SetMemoryBudget(UInt inBudgetBytes);
+    bool SetMemoryBudget(const std::string &in3CharExtName, UInt inBudgetBytes);
+
+    // see ResourceCache::SetAllocator and ResourceCache::Reset
+    bool SetAllocator(const std::string &in3CharExtName, ResourceMemoryAllocator *inAllocator);
+    bool ResetCache(const std::string &in3CharExtName);
+    UInt GetMemoryUsage();
+
+    // evict the globally least recently used unlinked resources until the global budget is met
+    UInt32 Trim(UInt32 inMaxEvictions=~UInt32(0));
+    void PrintStats();
+
+private:
+    ResourceCache *FindCache(const std::string &inLocation);
+    ResourceCache *FindCacheByType(const std::string &in3CharExtName);
+    void GetCaches(std::vector<ResourceCache*> &outCaches);
+    void ReloadChanged();
+
+private:
+    // resource type (3 char extension name) -> cache, caches are never removed
     std::unordered_map<std::string, std::shared_ptr<ResourceCache>> caches;
-};
+    std::mutex cachesMutex;
+
+    std::atomic<UInt> memoryBudget;
+    UInt32 numStreamingThreads;
+
+    // declared after caches so workers stop before the caches go away
+    std::shared_ptr<ResourceStreamer> streamer;
+    std::mutex requestMutex; // guards streamer creation and inFlight
+    std::unordered_map<std::string, std::shared_ptr<ResourceRequestState>> inFlight;
+    std::vector<std::shared_ptr<ResourceRequestState>> finalizeQueue;
 
+    // ResourceId hash -> location, entries are never removed so ResourceIds can point at them
+    std::unordered_map<UInt64, std::string> idRegistry;
+    std::mutex idMutex;
+
+    std::shared_ptr<ResourceWatcher> watcher;
+    std::vector<std::pair<ReloadCallback, void*>> subscribers; // unsubscribed slots are null
+};
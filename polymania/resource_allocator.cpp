@@ -0,0 +1,631 @@
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <list>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <atomic>
+#include <mutex>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "types.hpp"
+#include "asyncmodel.hpp"
+#include "resource.hpp"
+#include "resource_allocator.hpp"
+
+static const UInt HUGE_PAGE_SIZE = 2*1024*1024;
+
+static inline UInt AlignUp(UInt inValue, UInt inAlignment) {
+    return (inValue + inAlignment - 1) & ~(inAlignment - 1);
+}
+
+static inline UInt32 FindLastSet(UInt inValue) {
+    UInt32 bit = 0;
+    while(inValue >>= 1) bit++;
+    return bit;
+}
+
+static inline UInt32 FindFirstSet(UInt32 inValue) {
+    UInt32 bit = 0;
+    while(!(inValue & 1)) {
+        inValue >>= 1;
+        bit++;
+    }
+    return bit;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Pages
+
+#if defined(_WIN32)
+void *ResourcePageAllocate(UInt &ioSizeBytes, UInt inAlignment, bool hintHugePages) {
+    if(hintHugePages) {
+        // needs SeLockMemoryPrivilege, silently falls back to normal pages without it
+        UInt largePage = GetLargePageMinimum();
+        if(largePage && inAlignment <= largePage) {
+            UInt size = AlignUp(ioSizeBytes, largePage);
+            void *ptr = VirtualAlloc(0, size, MEM_RESERVE|MEM_COMMIT|MEM_LARGE_PAGES, PAGE_READWRITE);
+            if(ptr) {
+                ioSizeBytes = size;
+                return ptr;
+            }
+        }
+    }
+
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    UInt size = AlignUp(ioSizeBytes, info.dwPageSize);
+    if(inAlignment <= info.dwAllocationGranularity) {
+        void *ptr = VirtualAlloc(0, size, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+        if(ptr) ioSizeBytes = size;
+        return ptr;
+    }
+
+    // reserve enough to find an aligned address, then map exactly there
+    for(Int32 attempt = 0; attempt < 8; ++attempt) {
+        void *probe = VirtualAlloc(0, size + inAlignment, MEM_RESERVE, PAGE_NOACCESS);
+        if(!probe) return 0;
+        VirtualFree(probe, 0, MEM_RELEASE);
+        void *ptr = VirtualAlloc((void*)AlignUp(UInt(probe), inAlignment), size, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+        if(ptr) {
+            ioSizeBytes = size;
+            return ptr;
+        }
+    }
+    return 0;
+}
+
+void ResourcePageFree(void *inPtr, UInt inSizeBytes) {
+    VirtualFree(inPtr, 0, MEM_RELEASE);
+}
+#else
+void *ResourcePageAllocate(UInt &ioSizeBytes, UInt inAlignment, bool hintHugePages) {
+#ifdef MAP_HUGETLB
+    if(hintHugePages && inAlignment <= HUGE_PAGE_SIZE) {
+        UInt size = AlignUp(ioSizeBytes, HUGE_PAGE_SIZE);
+        void *ptr = mmap(0, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+        if(ptr != MAP_FAILED) {
+            ioSizeBytes = size;
+            return ptr;
+        }
+    }
+#endif
+
+    UInt pageSize = UInt(sysconf(_SC_PAGESIZE));
+    if(hintHugePages) inAlignment = std::max(inAlignment, HUGE_PAGE_SIZE);
+    inAlignment = std::max(inAlignment, pageSize);
+    UInt size = AlignUp(ioSizeBytes, hintHugePages ? HUGE_PAGE_SIZE : pageSize);
+
+    // over map and trim both ends to get the alignment
+    UInt mapped = size + inAlignment - pageSize;
+    UInt8 *raw = (UInt8*)mmap(0, mapped, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if((void*)raw == MAP_FAILED) return 0;
+
+    UInt8 *ptr = (UInt8*)AlignUp(UInt(raw), inAlignment);
+    if(ptr != raw) munmap(raw, ptr - raw);
+    if(raw + mapped != ptr + size) munmap(ptr + size, (raw + mapped) - (ptr + size));
+
+#ifdef MADV_HUGEPAGE
+    // transparent huge pages, the kernel may or may not honor it
+    if(hintHugePages) madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+
+    ioSizeBytes = size;
+    return ptr;
+}
+
+void ResourcePageFree(void *inPtr, UInt inSizeBytes) {
+    munmap(inPtr, inSizeBytes);
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+// Linear
+
+ResourceMemoryAllocatorLinear::ResourceMemoryAllocatorLinear(UInt inChunkSizeBytes, bool hintHugePages)
+    : current(0), offset(0), last(0), usedBytes(0), chunkSize(inChunkSizeBytes), hugePages(hintHugePages) {
+}
+
+ResourceMemoryAllocatorLinear::~ResourceMemoryAllocatorLinear() {
+    for(auto it = chunks.begin(); it != chunks.end(); ++it) {
+        ResourcePageFree(it->base, it->size);
+    }
+}
+
+void *ResourceMemoryAllocatorLinear::Allocate(UInt inSizeBytes, UInt32 inAlignment) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return AllocateLocked(inSizeBytes, inAlignment);
+}
+
+void *ResourceMemoryAllocatorLinear::AllocateLocked(UInt inSizeBytes, UInt32 inAlignment) {
+    inAlignment = std::max(inAlignment, UInt32(sizeof(UInt)));
+
+    // every allocation is preceded by its size so Reallocate knows how much to copy
+    while(current < chunks.size()) {
+        Chunk &chunk = chunks[current];
+        UInt start = AlignUp(UInt(chunk.base) + offset + sizeof(UInt), inAlignment) - UInt(chunk.base);
+        if(start + inSizeBytes <= chunk.size) {
+            usedBytes += start + inSizeBytes - offset;
+            offset = start + inSizeBytes;
+            last = chunk.base + start;
+            ((UInt*)last)[-1] = inSizeBytes;
+            return last;
+        }
+
+        // chunks kept from before a Reset are reused in order
+        usedBytes += chunk.size - offset;
+        current++;
+        offset = 0;
+    }
+
+    Chunk chunk;
+    chunk.size = std::max(chunkSize, inSizeBytes + inAlignment + sizeof(UInt));
+    chunk.base = (UInt8*)ResourcePageAllocate(chunk.size, inAlignment, hugePages);
+    if(!chunk.base) return 0;
+    chunks.push_back(chunk);
+    current = chunks.size() - 1;
+    offset = 0;
+    return AllocateLocked(inSizeBytes, inAlignment);
+}
+
+void *ResourceMemoryAllocatorLinear::Reallocate(void *inPtr, UInt inSize, UInt32 inAlignment) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(!inPtr) return AllocateLocked(inSize, inAlignment);
+
+    UInt oldSize = ((UInt*)inPtr)[-1];
+    if(inPtr == last) {
+        // the most recent allocation can grow or shrink in place
+        Chunk &chunk = chunks[current];
+        UInt start = (UInt8*)inPtr - chunk.base;
+        if(start + inSize <= chunk.size) {
+            usedBytes = usedBytes - oldSize + inSize;
+            offset = start + inSize;
+            ((UInt*)inPtr)[-1] = inSize;
+            return inPtr;
+        }
+    } else if(inSize <= oldSize) {
+        ((UInt*)inPtr)[-1] = inSize;
+        return inPtr;
+    }
+
+    void *ptr = AllocateLocked(inSize, inAlignment);
+    if(ptr) std::memcpy(ptr, inPtr, std::min(oldSize, inSize));
+    return ptr;
+}
+
+void ResourceMemoryAllocatorLinear::Free(void *inPtr) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(inPtr && inPtr == last) {
+        UInt start = (UInt8*)inPtr - chunks[current].base;
+        usedBytes -= offset - (start - sizeof(UInt));
+        offset = start - sizeof(UInt);
+        last = 0;
+    }
+}
+
+bool ResourceMemoryAllocatorLinear::Reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // keep the first chunk around for the next level, return the rest
+    for(UInt i = 1; i < chunks.size(); ++i) {
+        ResourcePageFree(chunks[i].base, chunks[i].size);
+    }
+    if(chunks.size() > 1) chunks.resize(1);
+
+    current = 0;
+    offset = 0;
+    last = 0;
+    usedBytes = 0;
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Pool
+
+ResourceMemoryAllocatorPool::ResourceMemoryAllocatorPool(bool hintHugePages, ResourceMemoryAllocator *inFallback)
+    : fallback(inFallback), slabSize(hintHugePages ? HUGE_PAGE_SIZE : 64*1024), hugePages(hintHugePages) {
+    std::memset(freeLists, 0, sizeof(freeLists));
+}
+
+ResourceMemoryAllocatorPool::~ResourceMemoryAllocatorPool() {
+    Reset();
+}
+
+void *ResourceMemoryAllocatorPool::Allocate(UInt inSizeBytes, UInt32 inAlignment) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return AllocateLocked(inSizeBytes, inAlignment);
+}
+
+void *ResourceMemoryAllocatorPool::AllocateLocked(UInt inSizeBytes, UInt32 inAlignment) {
+    // blocks are carved at multiples of their power of two size from slab aligned memory,
+    // so picking a class at least as large as the alignment is enough to honor it
+    UInt need = std::max(std::max(inSizeBytes, UInt(inAlignment)), UInt(1) << MIN_CLASS_LOG2);
+    if(need > (UInt(1) << MAX_CLASS_LOG2)) {
+        void *ptr = fallback->Allocate(inSizeBytes, inAlignment);
+        if(ptr) large[ptr] = inSizeBytes;
+        return ptr;
+    }
+
+    UInt32 cls = FindLastSet(need - 1) + 1 - MIN_CLASS_LOG2;
+    if(!freeLists[cls] && !NewSlab(cls)) return 0;
+
+    FreeBlock *block = freeLists[cls];
+    freeLists[cls] = block->next;
+    return block;
+}
+
+bool ResourceMemoryAllocatorPool::NewSlab(UInt32 inClass) {
+    UInt size = slabSize;
+    UInt8 *base = (UInt8*)ResourcePageAllocate(size, slabSize, hugePages);
+    if(!base) return false;
+
+    // a huge page mapping may come back larger, split it into several slabs
+    UInt blockSize = UInt(1) << (inClass + MIN_CLASS_LOG2);
+    for(UInt8 *slab = base; slab < base + size; slab += slabSize) {
+        slabs[UInt(slab)] = inClass;
+        for(UInt i = slabSize/blockSize; i > 0; --i) {
+            FreeBlock *block = (FreeBlock*)(slab + (i-1)*blockSize);
+            block->next = freeLists[inClass];
+            freeLists[inClass] = block;
+        }
+    }
+    return true;
+}
+
+UInt ResourceMemoryAllocatorPool::GetBlockSizeLocked(void *inPtr) const {
+    auto it = slabs.find(UInt(inPtr) & ~(slabSize - 1));
+    return it == slabs.end() ? 0 : UInt(1) << (it->second + MIN_CLASS_LOG2);
+}
+
+void *ResourceMemoryAllocatorPool::Reallocate(void *inPtr, UInt inSize, UInt32 inAlignment) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(!inPtr) return AllocateLocked(inSize, inAlignment);
+
+    UInt oldSize = GetBlockSizeLocked(inPtr);
+    if(oldSize) {
+        // stay in the block while it fits and is not mostly wasted
+        if(inSize <= oldSize && (inSize > oldSize/2 || oldSize == (UInt(1) << MIN_CLASS_LOG2))) return inPtr;
+    } else {
+        auto it = large.find(inPtr);
+        if(it == large.end()) return 0;
+        oldSize = it->second;
+        if(inSize > (UInt(1) << MAX_CLASS_LOG2)) {
+            void *ptr = fallback->Reallocate(inPtr, inSize, inAlignment);
+            if(ptr) {
+                large.erase(it);
+                large[ptr] = inSize;
+            }
+            return ptr;
+        }
+    }
+
+    void *ptr = AllocateLocked(inSize, inAlignment);
+    if(ptr) {
+        std::memcpy(ptr, inPtr, std::min(oldSize, inSize));
+        FreeLocked(inPtr);
+    }
+    return ptr;
+}
+
+void ResourceMemoryAllocatorPool::Free(void *inPtr) {
+    if(!inPtr) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    FreeLocked(inPtr);
+}
+
+void ResourceMemoryAllocatorPool::FreeLocked(void *inPtr) {
+    auto it = slabs.find(UInt(inPtr) & ~(slabSize - 1));
+    if(it != slabs.end()) {
+        FreeBlock *block = (FreeBlock*)inPtr;
+        block->next = freeLists[it->second];
+        freeLists[it->second] = block;
+        return;
+    }
+
+    auto itLarge = large.find(inPtr);
+    if(itLarge != large.end()) {
+        fallback->Free(inPtr);
+        large.erase(itLarge);
+    }
+}
+
+bool ResourceMemoryAllocatorPool::Reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for(auto it = slabs.begin(); it != slabs.end(); ++it) {
+        ResourcePageFree((void*)it->first, slabSize);
+    }
+    for(auto it = large.begin(); it != large.end(); ++it) {
+        fallback->Free(it->first);
+    }
+    slabs.clear();
+    large.clear();
+    std::memset(freeLists, 0, sizeof(freeLists));
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// TLSF
+
+static const UInt TLSF_HEADER = 16;
+static const UInt TLSF_MIN_PAYLOAD = 2*sizeof(void*);
+// the largest payload the free lists have a class for, everything is refused or cut to fit it
+static const UInt TLSF_MAX_BLOCK = (~UInt(0) >> (sizeof(UInt)*8 - ResourceMemoryAllocatorTlsf::FL_MAX)) & ~((UInt(1) << ResourceMemoryAllocatorTlsf::ALIGN_LOG2) - 1);
+
+struct ResourceMemoryAllocatorTlsf::Block {
+    enum {
+        FLAG_Free = 1,
+        FLAG_PrevFree = 2,
+        FLAG_Mask = 3
+    };
+
+    // header, padded so payloads keep the 16 byte alignment on 32bit too
+    Block *prevPhys; // only valid while the previous block is free
+    UInt sizeAndFlags; // payload size
+#if INTPTR_MAX == INT32_MAX
+    UInt32 pad[2];
+#endif
+
+    // payload, only used while free
+    Block *nextFree;
+    Block *prevFree;
+
+    inline UInt Size() const { return sizeAndFlags & ~UInt(FLAG_Mask); }
+    inline void SetSize(UInt inSize) { sizeAndFlags = inSize | (sizeAndFlags & FLAG_Mask); }
+    inline bool IsFree() const { return (sizeAndFlags & FLAG_Free) != 0; }
+    inline bool IsPrevFree() const { return (sizeAndFlags & FLAG_PrevFree) != 0; }
+    inline void *Payload() { return (UInt8*)this + TLSF_HEADER; }
+    inline Block *Next() { return (Block*)((UInt8*)Payload() + Size()); }
+
+    inline void SetFree(bool inFree) {
+        sizeAndFlags = inFree ? (sizeAndFlags | FLAG_Free) : (sizeAndFlags & ~UInt(FLAG_Free));
+        Block *next = Next();
+        next->sizeAndFlags = inFree ? (next->sizeAndFlags | FLAG_PrevFree) : (next->sizeAndFlags & ~UInt(FLAG_PrevFree));
+        if(inFree) next->prevPhys = this;
+    }
+
+    static inline Block *FromPayload(void *inPtr) { return (Block*)((UInt8*)inPtr - TLSF_HEADER); }
+};
+
+static inline void TlsfMapping(UInt inSize, UInt32 &outFl, UInt32 &outSl) {
+    typedef ResourceMemoryAllocatorTlsf T;
+    if(inSize < (UInt(1) << T::FL_SHIFT)) {
+        outFl = 0;
+        outSl = UInt32(inSize >> T::ALIGN_LOG2);
+    } else {
+        UInt32 fl = FindLastSet(inSize);
+        outSl = UInt32(inSize >> (fl - T::SL_LOG2)) ^ (1 << T::SL_LOG2);
+        outFl = fl - (T::FL_SHIFT - 1);
+    }
+}
+
+ResourceMemoryAllocatorTlsf::ResourceMemoryAllocatorTlsf(UInt inRegionSizeBytes, bool hintHugePages)
+    : flBitmap(0), regionSize(inRegionSizeBytes), hugePages(hintHugePages) {
+    std::memset(slBitmap, 0, sizeof(slBitmap));
+    std::memset(freeLists, 0, sizeof(freeLists));
+}
+
+ResourceMemoryAllocatorTlsf::~ResourceMemoryAllocatorTlsf() {
+    ReleaseRegions();
+}
+
+void ResourceMemoryAllocatorTlsf::InsertFree(Block *inBlock) {
+    UInt32 fl, sl;
+    TlsfMapping(inBlock->Size(), fl, sl);
+    Block *head = freeLists[fl][sl];
+    inBlock->nextFree = head;
+    inBlock->prevFree = 0;
+    if(head) head->prevFree = inBlock;
+    freeLists[fl][sl] = inBlock;
+    flBitmap |= 1u << fl;
+    slBitmap[fl] |= 1u << sl;
+}
+
+void ResourceMemoryAllocatorTlsf::RemoveFree(Block *inBlock) {
+    UInt32 fl, sl;
+    TlsfMapping(inBlock->Size(), fl, sl);
+    if(inBlock->prevFree) inBlock->prevFree->nextFree = inBlock->nextFree;
+    if(inBlock->nextFree) inBlock->nextFree->prevFree = inBlock->prevFree;
+    if(freeLists[fl][sl] == inBlock) {
+        freeLists[fl][sl] = inBlock->nextFree;
+        if(!inBlock->nextFree) {
+            slBitmap[fl] &= ~(1u << sl);
+            if(!slBitmap[fl]) flBitmap &= ~(1u << fl);
+        }
+    }
+}
+
+ResourceMemoryAllocatorTlsf::Block *ResourceMemoryAllocatorTlsf::FindFree(UInt inSize) {
+    // round up to the next list so any block found is large enough
+    if(inSize >= (UInt(1) << FL_SHIFT)) {
+        UInt rounded = inSize + (UInt(1) << (FindLastSet(inSize) - SL_LOG2)) - 1;
+        if(rounded < inSize) return 0; // wrapped on 32bit, no block is that big
+        inSize = rounded;
+    }
+    UInt32 fl, sl;
+    TlsfMapping(inSize, fl, sl);
+    if(fl >= FL_COUNT) return 0;
+
+    UInt32 slMap = slBitmap[fl] & (~0u << sl);
+    if(!slMap) {
+        UInt32 flMap = fl + 1 < 32 ? flBitmap & (~0u << (fl + 1)) : 0;
+        if(!flMap) return 0;
+        fl = FindFirstSet(flMap);
+        slMap = slBitmap[fl];
+    }
+    sl = FindFirstSet(slMap);
+
+    Block *block = freeLists[fl][sl];
+    RemoveFree(block);
+    return block;
+}
+
+void ResourceMemoryAllocatorTlsf::SplitTrailing(Block *inBlock, UInt inSize) {
+    if(inBlock->Size() < inSize + TLSF_HEADER + TLSF_MIN_PAYLOAD) return;
+
+    // inBlock is in use, so the remainder only ever merges forward
+    Block *rest = (Block*)((UInt8*)inBlock->Payload() + inSize);
+    rest->sizeAndFlags = 0;
+    rest->SetSize(inBlock->Size() - inSize - TLSF_HEADER);
+    inBlock->SetSize(inSize);
+    rest->prevPhys = inBlock;
+    rest->SetFree(true);
+    InsertFree(MergeFree(rest));
+}
+
+ResourceMemoryAllocatorTlsf::Block *ResourceMemoryAllocatorTlsf::MergeFree(Block *inBlock) {
+    // inBlock is free but not in a list, neighbours that are free get absorbed
+    Block *next = inBlock->Next();
+    if(next->IsFree()) {
+        RemoveFree(next);
+        inBlock->SetSize(inBlock->Size() + TLSF_HEADER + next->Size());
+        inBlock->SetFree(true);
+    }
+    if(inBlock->IsPrevFree()) {
+        Block *prev = inBlock->prevPhys;
+        RemoveFree(prev);
+        prev->SetSize(prev->Size() + TLSF_HEADER + inBlock->Size());
+        prev->SetFree(true);
+        inBlock = prev;
+    }
+    return inBlock;
+}
+
+bool ResourceMemoryAllocatorTlsf::AddRegion(UInt inMinPayloadBytes) {
+    if(inMinPayloadBytes > TLSF_MAX_BLOCK - 3*TLSF_HEADER) return false;
+
+    Region region;
+    region.size = std::max(regionSize, inMinPayloadBytes + 3*TLSF_HEADER);
+    region.base = ResourcePageAllocate(region.size, TLSF_HEADER, hugePages);
+    if(!region.base) return false;
+    regions.push_back(region);
+
+    // free blocks of at most TLSF_MAX_BLOCK, usually one spanning the region, each followed by a zero
+    // sized used sentinel so they never merge into a block without a size class
+    UInt8 *at = (UInt8*)region.base;
+    UInt left = region.size;
+    while(left >= 2*TLSF_HEADER + TLSF_MIN_PAYLOAD) {
+        UInt size = std::min(left - 2*TLSF_HEADER, TLSF_MAX_BLOCK);
+        Block *block = (Block*)at;
+        block->prevPhys = 0;
+        block->sizeAndFlags = 0;
+        block->SetSize(size);
+        Block *sentinel = block->Next();
+        sentinel->sizeAndFlags = 0;
+        block->SetFree(true);
+        InsertFree(block);
+        at = (UInt8*)sentinel + TLSF_HEADER;
+        left -= size + 2*TLSF_HEADER;
+    }
+    return true;
+}
+
+void ResourceMemoryAllocatorTlsf::ReleaseRegions() {
+    for(auto it = regions.begin(); it != regions.end(); ++it) {
+        ResourcePageFree(it->base, it->size);
+    }
+    regions.clear();
+    flBitmap = 0;
+    std::memset(slBitmap, 0, sizeof(slBitmap));
+    std::memset(freeLists, 0, sizeof(freeLists));
+}
+
+void *ResourceMemoryAllocatorTlsf::Allocate(UInt inSizeBytes, UInt32 inAlignment) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return AllocateLocked(inSizeBytes, inAlignment);
+}
+
+void *ResourceMemoryAllocatorTlsf::AllocateLocked(UInt inSizeBytes, UInt32 inAlignment) {
+    if(inSizeBytes > TLSF_MAX_BLOCK) return 0;
+    UInt size = AlignUp(std::max(inSizeBytes, TLSF_MIN_PAYLOAD), UInt(1) << ALIGN_LOG2);
+    bool overAligned = inAlignment > (1u << ALIGN_LOG2);
+
+    // over aligned requests need room to cut a free block off the front
+    UInt extra = overAligned ? inAlignment + TLSF_HEADER + TLSF_MIN_PAYLOAD : 0;
+    if(size > TLSF_MAX_BLOCK - extra) return 0;
+    UInt search = size + extra;
+    Block *block = FindFree(search);
+    if(!block) {
+        if(!AddRegion(search)) return 0;
+        block = FindFree(search);
+        if(!block) return 0;
+    }
+
+    if(overAligned) {
+        UInt payload = UInt(block->Payload());
+        UInt aligned = AlignUp(payload, inAlignment);
+        if(aligned != payload && aligned - payload < TLSF_HEADER + TLSF_MIN_PAYLOAD) {
+            aligned = AlignUp(payload + TLSF_HEADER + TLSF_MIN_PAYLOAD, inAlignment);
+        }
+        if(aligned != payload) {
+            // the front part stays free, its previous block is used since block was free
+            Block *front = block;
+            block = Block::FromPayload((void*)aligned);
+            block->sizeAndFlags = 0;
+            block->SetSize(front->Size() - (aligned - payload));
+            front->SetSize(aligned - payload - TLSF_HEADER);
+            block->prevPhys = front;
+            block->sizeAndFlags |= Block::FLAG_Free | Block::FLAG_PrevFree;
+            InsertFree(front);
+        }
+    }
+
+    block->SetFree(false);
+    SplitTrailing(block, size);
+    return block->Payload();
+}
+
+void *ResourceMemoryAllocatorTlsf::Reallocate(void *inPtr, UInt inSize, UInt32 inAlignment) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(!inPtr) return AllocateLocked(inSize, inAlignment);
+    if(inSize > TLSF_MAX_BLOCK) return 0;
+
+    Block *block = Block::FromPayload(inPtr);
+    UInt size = AlignUp(std::max(inSize, TLSF_MIN_PAYLOAD), UInt(1) << ALIGN_LOG2);
+    UInt oldSize = block->Size();
+
+    // grow into a free neighbour, the address and so the alignment stay the same
+    Block *next = block->Next();
+    if(size > oldSize && next->IsFree() && oldSize + TLSF_HEADER + next->Size() >= size) {
+        RemoveFree(next);
+        block->SetSize(oldSize + TLSF_HEADER + next->Size());
+        block->SetFree(false);
+    }
+    if(size <= block->Size()) {
+        SplitTrailing(block, size);
+        return inPtr;
+    }
+
+    void *ptr = AllocateLocked(inSize, inAlignment);
+    if(ptr) {
+        std::memcpy(ptr, inPtr, oldSize);
+        FreeLocked(inPtr);
+    }
+    return ptr;
+}
+
+void ResourceMemoryAllocatorTlsf::Free(void *inPtr) {
+    if(!inPtr) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    FreeLocked(inPtr);
+}
+
+void ResourceMemoryAllocatorTlsf::FreeLocked(void *inPtr) {
+    Block *block = Block::FromPayload(inPtr);
+    block->SetFree(true);
+    InsertFree(MergeFree(block));
+}
+
+bool ResourceMemoryAllocatorTlsf::Reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    ReleaseRegions();
+    return true;
+}
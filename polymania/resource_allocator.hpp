@@ -0,0 +1,134 @@
+#pragma once
+
+// whole pages straight from the OS, ioSizeBytes is rounded up to what was actually mapped
+void *ResourcePageAllocate(UInt &ioSizeBytes, UInt inAlignment, bool hintHugePages);
+void ResourcePageFree(void *inPtr, UInt inSizeBytes);
+
+/*
+ * Bump allocator for level lifetime data, Free only rolls back the most recent
+ * allocation and everything else is released at once by Reset
+ */
+class ResourceMemoryAllocatorLinear : public ResourceMemoryAllocator {
+public:
+    ResourceMemoryAllocatorLinear(UInt inChunkSizeBytes=4*1024*1024, bool hintHugePages=false);
+    ~ResourceMemoryAllocatorLinear();
+
+    void *Allocate(UInt inSizeBytes, UInt32 inAlignment);
+    void *Reallocate(void *inPtr, UInt inSize, UInt32 inAlignment);
+    void Free(void *inPtr);
+    bool Reset();
+
+    UInt GetUsedBytes() const { return usedBytes; }
+
+private:
+    struct Chunk {
+        UInt8 *base;
+        UInt size;
+    };
+
+    void *AllocateLocked(UInt inSizeBytes, UInt32 inAlignment);
+
+private:
+    std::mutex mutex;
+    std::vector<Chunk> chunks;
+    UInt current; // chunk being bumped
+    UInt offset; // within the current chunk
+    UInt8 *last; // most recent allocation, can be grown or freed in place
+    UInt usedBytes; // bytes handed out in previous chunks + offset
+    UInt chunkSize;
+    bool hugePages;
+};
+
+/*
+ * Segregated free lists of power of two size classes carved from aligned slabs,
+ * requests above the largest class go to the fallback allocator
+ */
+class ResourceMemoryAllocatorPool : public ResourceMemoryAllocator {
+public:
+    enum {
+        MIN_CLASS_LOG2 = 4, // 16 bytes
+        MAX_CLASS_LOG2 = 14, // 16 KB
+        NUM_CLASSES = MAX_CLASS_LOG2 - MIN_CLASS_LOG2 + 1
+    };
+
+public:
+    ResourceMemoryAllocatorPool(bool hintHugePages=false, ResourceMemoryAllocator *inFallback=ResourceMemoryAllocator::instance);
+    ~ResourceMemoryAllocatorPool();
+
+    void *Allocate(UInt inSizeBytes, UInt32 inAlignment);
+    void *Reallocate(void *inPtr, UInt inSize, UInt32 inAlignment);
+    void Free(void *inPtr);
+    bool Reset();
+
+private:
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    void *AllocateLocked(UInt inSizeBytes, UInt32 inAlignment);
+    void FreeLocked(void *inPtr);
+    // returns 0 for pointers not owned by a slab
+    UInt GetBlockSizeLocked(void *inPtr) const;
+    bool NewSlab(UInt32 inClass);
+
+private:
+    std::mutex mutex;
+    FreeBlock *freeLists[NUM_CLASSES];
+    std::unordered_map<UInt, UInt32> slabs; // slab base -> size class
+    std::unordered_map<void*, UInt> large; // fallback allocation -> size
+    ResourceMemoryAllocator *fallback;
+    UInt slabSize;
+    bool hugePages;
+};
+
+/*
+ * Two level segregated fit general purpose allocator, O(1) allocate and free with
+ * immediate coalescing, grows by mapping new regions
+ */
+class ResourceMemoryAllocatorTlsf : public ResourceMemoryAllocator {
+public:
+    enum {
+        ALIGN_LOG2 = 4,
+        SL_LOG2 = 4,
+        FL_SHIFT = SL_LOG2 + ALIGN_LOG2,
+        FL_MAX = 32, // blocks up to 4 GB
+        FL_COUNT = FL_MAX - FL_SHIFT + 1,
+        SL_COUNT = 1 << SL_LOG2
+    };
+
+public:
+    ResourceMemoryAllocatorTlsf(UInt inRegionSizeBytes=16*1024*1024, bool hintHugePages=false);
+    ~ResourceMemoryAllocatorTlsf();
+
+    void *Allocate(UInt inSizeBytes, UInt32 inAlignment);
+    void *Reallocate(void *inPtr, UInt inSize, UInt32 inAlignment);
+    void Free(void *inPtr);
+    bool Reset();
+
+private:
+    struct Block;
+    struct Region {
+        void *base;
+        UInt size;
+    };
+
+    void *AllocateLocked(UInt inSizeBytes, UInt32 inAlignment);
+    void FreeLocked(void *inPtr);
+    bool AddRegion(UInt inMinPayloadBytes);
+    void ReleaseRegions();
+
+    Block *FindFree(UInt inSize);
+    void InsertFree(Block *inBlock);
+    void RemoveFree(Block *inBlock);
+    void SplitTrailing(Block *inBlock, UInt inSize);
+    Block *MergeFree(Block *inBlock);
+
+private:
+    std::mutex mutex;
+    UInt32 flBitmap;
+    UInt32 slBitmap[FL_COUNT];
+    Block *freeLists[FL_COUNT][SL_COUNT];
+    std::vector<Region> regions;
+    UInt regionSize;
+    bool hugePages;
+};
@@ -0,0 +1,135 @@
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <list>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <atomic>
+#include <mutex>
+
+#include "types.hpp"
+#include "asyncmodel.hpp"
+#include "resource.hpp"
+#include "resource_dedup.hpp"
+
+ResourceBlobStore *ResourceBlobStore::instance = 0;
+
+// header in front of the payload, padded so the payload keeps BLOB_ALIGNMENT
+struct ResourceBlobStore::Blob {
+    UInt64 hash;
+    UInt size;
+    UInt32 refs;
+};
+
+// multiple of BLOB_ALIGNMENT that fits Blob on 32 and 64 bit
+static const UInt BLOB_HEADER = 32;
+
+ResourceBlobStore::ResourceBlobStore(ResourceMemoryAllocator *inAllocator) : allocator(inAllocator) {
+}
+
+ResourceBlobStore::~ResourceBlobStore() {
+    if(!blobs.empty()) {
+        std::cerr << "ResourceBlobStore: " << blobs.size() << " blobs still acquired at shutdown" << std::endl;
+    }
+}
+
+UInt64 ResourceBlobStore::Hash(const void *inData, UInt inSizeBytes) {
+    const UInt64 m = 0xc6a4a7935bd1e995ULL;
+    const Int32 r = 47;
+    UInt64 h = 0x8445d61a4e774912ULL ^ (UInt64(inSizeBytes) * m);
+
+    const UInt8 *data = (const UInt8*)inData;
+    const UInt8 *end = data + (inSizeBytes & ~UInt(7));
+    for(; data != end; data += 8) {
+        UInt64 k;
+        std::memcpy(&k, data, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    UInt tail = inSizeBytes & 7;
+    if(tail) {
+        for(UInt i = 0; i < tail; ++i) {
+            h ^= UInt64(data[i]) << (8*i);
+        }
+        h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+const void *ResourceBlobStore::Acquire(const void *inData, UInt inSizeBytes) {
+    static_assert(sizeof(Blob) <= BLOB_HEADER && BLOB_HEADER % BLOB_ALIGNMENT == 0, "blob header too small");
+    UInt64 hash = Hash(inData, inSizeBytes);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.sharedBytes += inSizeBytes;
+    auto range = blobs.equal_range(hash);
+    for(auto it = range.first; it != range.second; ++it) {
+        Blob *blob = it->second;
+        if(blob->size == inSizeBytes && std::memcmp((UInt8*)blob + BLOB_HEADER, inData, inSizeBytes) == 0) {
+            blob->refs++;
+            stats.hits++;
+            return (UInt8*)blob + BLOB_HEADER;
+        }
+    }
+
+    Blob *blob = (Blob*)allocator->Allocate(BLOB_HEADER + inSizeBytes, BLOB_ALIGNMENT);
+    if(!blob) {
+        stats.sharedBytes -= inSizeBytes;
+        return 0;
+    }
+    blob->hash = hash;
+    blob->size = inSizeBytes;
+    blob->refs = 1;
+    std::memcpy((UInt8*)blob + BLOB_HEADER, inData, inSizeBytes);
+    blobs.insert(std::make_pair(hash, blob));
+
+    stats.misses++;
+    stats.uniqueBytes += inSizeBytes;
+    stats.numBlobs++;
+    return (UInt8*)blob + BLOB_HEADER;
+}
+
+void ResourceBlobStore::Release(const void *inBlob) {
+    if(!inBlob) return;
+    Blob *blob = (Blob*)((UInt8*)inBlob - BLOB_HEADER);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.sharedBytes -= blob->size;
+    if(--blob->refs > 0) return;
+
+    auto range = blobs.equal_range(blob->hash);
+    for(auto it = range.first; it != range.second; ++it) {
+        if(it->second == blob) {
+            blobs.erase(it);
+            break;
+        }
+    }
+    stats.uniqueBytes -= blob->size;
+    stats.numBlobs--;
+    allocator->Free(blob);
+}
+
+ResourceBlobStats ResourceBlobStore::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void ResourceBlobStore::PrintStats() {
+    ResourceBlobStats s = GetStats();
+    std::cout << "Resource blobs: "
+        "hits=" << s.hits << " "
+        "misses=" << s.misses << " "
+        "blobs=" << s.numBlobs << " "
+        "unique=" << s.uniqueBytes << " "
+        "shared=" << s.sharedBytes << " "
+        "saved=" << (s.sharedBytes - s.uniqueBytes) << std::endl;
+}
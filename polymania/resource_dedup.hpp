@@ -0,0 +1,45 @@
+#pragma once
+
+struct ResourceBlobStats {
+    UInt64 hits; // acquires that found an identical payload
+    UInt64 misses;
+    UInt uniqueBytes; // actually allocated
+    UInt sharedBytes; // what the same acquires would have cost without deduplication
+    UInt32 numBlobs;
+
+    ResourceBlobStats() : hits(0), misses(0), uniqueBytes(0), sharedBytes(0), numBlobs(0) {}
+};
+
+/*
+ * Content addressed store of immutable payloads, resources with identical bytes
+ * under different locations share one refcounted allocation
+ */
+class ResourceBlobStore {
+public:
+    static ResourceBlobStore *instance; // null disables deduplication
+
+public:
+    ResourceBlobStore(ResourceMemoryAllocator *inAllocator=ResourceMemoryAllocator::instance);
+    ~ResourceBlobStore(); // blobs still acquired are reported and leaked
+
+    // returns a shared read only copy of inData, every Acquire needs a matching Release
+    const void *Acquire(const void *inData, UInt inSizeBytes);
+    void Release(const void *inBlob);
+
+    ResourceBlobStats GetStats();
+    void PrintStats();
+
+    // fast non cryptographic 64 bit hash (MurmurHash64A), equal hashes are always verified with memcmp
+    static UInt64 Hash(const void *inData, UInt inSizeBytes);
+
+private:
+    struct Blob;
+
+    enum { BLOB_ALIGNMENT = 16 };
+
+private:
+    std::mutex mutex;
+    ResourceMemoryAllocator *allocator;
+    std::unordered_multimap<UInt64, Blob*> blobs; // content hash -> blob
+    ResourceBlobStats stats;
+};
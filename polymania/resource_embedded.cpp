@@ -0,0 +1,143 @@
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <list>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <mutex>
+
+#include "types.hpp"
+#include "asyncmodel.hpp"
+#include "resource.hpp"
+#include "resource_embedded.hpp"
+
+class ResourceIoEmbedded : public ResourceIo {
+public:
+    ResourceIoEmbedded(const ResourceEmbeddedEntry &inEntry) : data(inEntry.data), size(inEntry.size), pos(0) {
+    }
+
+    AsyncResult<Int> Read(void *outBuffer, UInt inSizeBytes) {
+        AsyncResult<Int> result;
+        UInt bytes = std::min(inSizeBytes, size - pos);
+        std::memcpy(outBuffer, data + pos, bytes);
+        pos += bytes;
+        result.syncResult = Int(bytes);
+        return result;
+    }
+    AsyncResult<Int> Write(const void *inBuffer, UInt inSizeBytes) {
+        AsyncResult<Int> result;
+        result.syncResult = 0;
+        return result;
+    }
+    bool Seek(UInt inOffset, Int32 inOrigin) {
+        // inOffset is unsigned, ORIGIN_End can only seek to the end itself
+        UInt target;
+        switch(inOrigin) {
+            case ORIGIN_Set:
+                target = inOffset;
+                break;
+            case ORIGIN_Cur:
+                target = pos + inOffset;
+                break;
+            case ORIGIN_End:
+                target = size + inOffset;
+                break;
+            default:
+                return false;
+        }
+        if(target > size) return false;
+        pos = target;
+        return true;
+    }
+    Int Tell() const {
+        return Int(pos);
+    }
+    bool IsWritable() const {
+        return false;
+    }
+    bool IsSeekable() const {
+        return true;
+    }
+    const void *Map(UInt &outSizeBytes) {
+        outSizeBytes = size;
+        return data;
+    }
+    bool IsMapTerminated() const {
+        // tools/embed_resources writes a 0 after every array
+        return true;
+    }
+
+private:
+    const UInt8 *data;
+    UInt size;
+    UInt pos;
+};
+
+// an io opened through the fallback directory, closed by dropping the reference
+class ResourceIoFallback : public ResourceIo {
+public:
+    ResourceIoFallback(const std::shared_ptr<ResourceIo> &inIo) : io(inIo) {
+    }
+
+    AsyncResult<Int> Read(void *outBuffer, UInt inSizeBytes) { return io->Read(outBuffer, inSizeBytes); }
+    AsyncResult<Int> Write(const void *inBuffer, UInt inSizeBytes) { return io->Write(inBuffer, inSizeBytes); }
+    bool Seek(UInt inOffset, Int32 inOrigin) { return io->Seek(inOffset, inOrigin); }
+    Int Tell() const { return io->Tell(); }
+    bool IsWritable() const { return io->IsWritable(); }
+    bool IsSeekable() const { return io->IsSeekable(); }
+    const void *Map(UInt &outSizeBytes) { return io->Map(outSizeBytes); }
+    bool IsMapTerminated() const { return io->IsMapTerminated(); }
+
+private:
+    std::shared_ptr<ResourceIo> io;
+};
+
+static bool CompareEntryLocation(const ResourceEmbeddedEntry &inEntry, const char *inLocation) {
+    return std::strcmp(inEntry.location, inLocation) < 0;
+}
+
+ResourceDirectoryEmbedded::ResourceDirectoryEmbedded(const ResourceEmbeddedEntry *inIndex, UInt32 inCount, ResourceDirectory *inFallback) 
+    : index(inIndex), count(inCount), fallback(inFallback) {
+}
+
+bool ResourceDirectoryEmbedded::IsWritable() const {
+    return fallback ? fallback->IsWritable() : false;
+}
+
+bool ResourceDirectoryEmbedded::Readahead(const std::string &inLocation, UInt64 inOffset, UInt64 inSizeBytes) {
+    if(Find(inLocation)) return true;
+    return fallback ? fallback->Readahead(inLocation, inOffset, inSizeBytes) : false;
+}
+
+bool ResourceDirectoryEmbedded::Prefetch(const std::string &inLocation, UInt64 inOffset, UInt64 inSizeBytes) {
+    if(Find(inLocation)) return true;
+    return fallback ? fallback->Prefetch(inLocation, inOffset, inSizeBytes) : false;
+}
+
+const ResourceEmbeddedEntry *ResourceDirectoryEmbedded::Find(const std::string &inLocation) const {
+    const ResourceEmbeddedEntry *end = index + count;
+    const ResourceEmbeddedEntry *it = std::lower_bound(index, end, inLocation.c_str(), &CompareEntryLocation);
+    return it != end && inLocation == it->location ? it : 0;
+}
+
+ResourceIo *ResourceDirectoryEmbedded::InternalOpen(const std::string &inLocation, Int32 inPermission) {
+    // embedded data is read only, writes always go to the fallback
+    const ResourceEmbeddedEntry *entry = inPermission == PERMISSION_ReadOnly ? Find(inLocation) : 0;
+    if(entry) {
+        void *raw = ResourceMemoryAllocator::instance->Allocate(sizeof(ResourceIoEmbedded));
+        return new(raw)ResourceIoEmbedded(*entry);
+    }
+
+    if(!fallback) return 0;
+    std::shared_ptr<ResourceIo> io = fallback->Open(inLocation, inPermission).GetResult();
+    if(!io) return 0;
+    void *raw = ResourceMemoryAllocator::instance->Allocate(sizeof(ResourceIoFallback));
+    return new(raw)ResourceIoFallback(io);
+}
+
+void ResourceDirectoryEmbedded::InternalClose(ResourceIo *res) {
+    res->~ResourceIo();
+    ResourceMemoryAllocator::instance->Free(res);
+}
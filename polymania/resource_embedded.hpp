@@ -0,0 +1,43 @@
+#pragma once
+
+#if defined(_MSC_VER)
+#define RESOURCE_EMBEDDED_ALIGN __declspec(align(16))
+#else
+#define RESOURCE_EMBEDDED_ALIGN __attribute__((aligned(16)))
+#endif
+
+struct ResourceEmbeddedEntry {
+    const char *location;
+    const UInt8 *data; // followed by a 0 byte that is not counted in size, so text can be used in place
+    UInt size;
+};
+
+// generated by tools/embed_resources for builds with POLYMANIA_EMBEDDED_RESOURCES, sorted by location
+extern const ResourceEmbeddedEntry ResourceEmbeddedIndex[];
+extern const UInt32 ResourceEmbeddedCount;
+
+/*
+ * Serves resources compiled into the binary straight from memory,
+ * every other location is passed on to the fallback directory.
+ * Embedded locations never change, so they do not hot reload
+ */
+class ResourceDirectoryEmbedded : public ResourceDirectory {
+public:
+    ResourceDirectoryEmbedded(const ResourceEmbeddedEntry *inIndex, UInt32 inCount, ResourceDirectory *inFallback);
+
+    bool IsWritable() const;
+    bool Readahead(const std::string &inLocation, UInt64 inOffset, UInt64 inSizeBytes);
+    bool Prefetch(const std::string &inLocation, UInt64 inOffset, UInt64 inSizeBytes);
+
+    // null if inLocation is not embedded
+    const ResourceEmbeddedEntry *Find(const std::string &inLocation) const;
+
+protected:
+    ResourceIo *InternalOpen(const std::string &inLocation, Int32 inPermission);
+    void InternalClose(ResourceIo *res);
+
+private:
+    const ResourceEmbeddedEntry *index;
+    UInt32 count;
+    ResourceDirectory *fallback;
+};
@@ -0,0 +1,165 @@
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <unordered_map>
+#include <list>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <mutex>
+
+#include "types.hpp"
+#include "asyncmodel.hpp"
+#include "resource.hpp"
+#include "resource_prefetch.hpp"
+
+ResourceAccessTrace::ResourceAccessTrace(double inMaxSeconds) : start(std::chrono::steady_clock::now()), maxSeconds(inMaxSeconds) {
+}
+
+UInt32 ResourceAccessTrace::Touch(const std::string &inLocation) {
+    double now = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = recordIds.find(inLocation);
+    if(it != recordIds.end()) return it->second;
+    if(maxSeconds > 0.0 && now > maxSeconds) return INVALID_RECORD;
+
+    UInt32 id = UInt32(records.size());
+    records.push_back(ResourceAccessRecord());
+    records.back().location = inLocation;
+    records.back().firstTouch = now;
+    recordIds[inLocation] = id;
+    return id;
+}
+
+void ResourceAccessTrace::RecordRead(UInt32 inRecord, UInt64 inOffset, UInt64 inSizeBytes) {
+    if(inRecord == INVALID_RECORD || !inSizeBytes) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ResourceAccessRecord &r = records[inRecord];
+    if(!r.size) {
+        r.offset = inOffset;
+        r.size = inSizeBytes;
+    } else {
+        UInt64 end = std::max(r.offset + r.size, inOffset + inSizeBytes);
+        r.offset = std::min(r.offset, inOffset);
+        r.size = end - r.offset;
+    }
+}
+
+void ResourceAccessTrace::GetRecords(std::vector<ResourceAccessRecord> &outRecords) {
+    std::lock_guard<std::mutex> lock(mutex);
+    outRecords = records;
+}
+
+bool ResourceAccessTrace::Save(const std::string &inLocation) {
+    std::vector<ResourceAccessRecord> all;
+    GetRecords(all);
+
+    auto resIo = ResourceDirectory::instance->Open(inLocation, ResourceDirectory::PERMISSION_ReadWriteTruncate).GetResult();
+    if(!resIo) return false;
+
+    char line[64];
+    for(auto it = all.begin(); it != all.end(); ++it) {
+        if(!it->size) continue;
+        Int len = std::sprintf(line, "%.4f %llu %llu ", it->firstTouch, (unsigned long long)it->offset, (unsigned long long)it->size);
+        resIo->Write(line, UInt(len));
+        resIo->Write(it->location.c_str(), UInt(it->location.size()));
+        resIo->Write("\n", 1);
+    }
+    return true;
+}
+
+bool ResourceAccessTrace::Load(const std::string &inLocation, std::vector<ResourceAccessRecord> &outRecords) {
+    auto resIo = ResourceDirectory::instance->Open(inLocation, ResourceDirectory::PERMISSION_ReadOnly).GetResult();
+    if(!resIo) return false;
+
+    std::string text;
+    char buf[1024];
+    Int bytesRead;
+    while((bytesRead = resIo->Read(buf, sizeof(buf)).GetResult()) > 0) {
+        text.append(buf, bytesRead);
+    }
+
+    size_t lineStart = 0;
+    while(lineStart < text.size()) {
+        size_t lineEnd = text.find('\n', lineStart);
+        if(lineEnd == std::string::npos) lineEnd = text.size();
+        std::string line = text.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+
+        ResourceAccessRecord r;
+        unsigned long long offset, size;
+        int consumed = 0;
+        if(std::sscanf(line.c_str(), "%lf %llu %llu %n", &r.firstTouch, &offset, &size, &consumed) < 3 || !consumed) continue;
+        r.offset = offset;
+        r.size = size;
+        r.location = line.substr(consumed);
+        if(!r.location.empty() && r.location[r.location.size()-1] == '\r') r.location.erase(r.location.size()-1);
+        if(!r.location.empty()) outRecords.push_back(r);
+    }
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+AsyncResult<Int> ResourceIoTraced::Read(void *outBuffer, UInt inSizeBytes) {
+    Int offset = io->Tell();
+    AsyncResult<Int> result = io->Read(outBuffer, inSizeBytes);
+    Int bytesRead = result.GetResult();
+    if(offset >= 0 && bytesRead > 0) trace->RecordRead(record, UInt64(offset), UInt64(bytesRead));
+    return result;
+}
+
+const void *ResourceIoTraced::Map(UInt &outSizeBytes) {
+    const void *mapped = io->Map(outSizeBytes);
+    // no way to tell which pages get touched, assume all of them
+    if(mapped) trace->RecordRead(record, 0, outSizeBytes);
+    return mapped;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+ResourcePrefetcher::ResourcePrefetcher() : dir(0), nextHint(0), nextRead(0), numFinished(0), quit(false) {
+}
+
+ResourcePrefetcher::~ResourcePrefetcher() {
+    Stop();
+}
+
+void ResourcePrefetcher::Start(ResourceDirectory &inDir, const std::vector<ResourceAccessRecord> &inRecords, UInt32 inNumThreads) {
+    Stop();
+    dir = &inDir;
+    records = inRecords;
+    nextHint = 0;
+    nextRead = 0;
+    numFinished = 0;
+    quit = false;
+    for(UInt32 i = 0; i < std::max(inNumThreads, 1u); ++i) {
+        workers.push_back(std::thread(&ResourcePrefetcher::WorkerMain, this));
+    }
+}
+
+void ResourcePrefetcher::Stop() {
+    quit = true;
+    for(auto it = workers.begin(); it != workers.end(); ++it) {
+        it->join();
+    }
+    workers.clear();
+}
+
+void ResourcePrefetcher::WorkerMain() {
+    // hints are cheap and let the kernel schedule all reads at once, so they all go out first
+    for(UInt32 i = nextHint++; i < records.size() && !quit; i = nextHint++) {
+        dir->Readahead(records[i].location, records[i].offset, records[i].size);
+    }
+    // reading through covers file systems that ignore the hints
+    for(UInt32 i = nextRead++; i < records.size() && !quit; i = nextRead++) {
+        dir->Prefetch(records[i].location, records[i].offset, records[i].size);
+    }
+    numFinished++;
+}
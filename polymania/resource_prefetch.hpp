@@ -0,0 +1,89 @@
+#pragma once
+
+struct ResourceAccessRecord {
+    std::string location;
+    UInt64 offset; // lowest byte read
+    UInt64 size; // from offset up to the highest byte read, 0 if the file was opened but never read
+    double firstTouch; // seconds since tracing started
+
+    ResourceAccessRecord() : offset(0), size(0), firstTouch(0.0) {}
+};
+
+/*
+ * Records which resource files are opened, in which order and which bytes of them are read,
+ * so the next run can prefetch them before anyone asks
+ */
+class ResourceAccessTrace {
+public:
+    enum { INVALID_RECORD = ~UInt32(0) };
+
+public:
+    // accesses later than inMaxSeconds after construction are ignored, 0 records the whole run
+    ResourceAccessTrace(double inMaxSeconds=0.0);
+
+    // returns the record of inLocation or INVALID_RECORD once the trace window is over
+    UInt32 Touch(const std::string &inLocation);
+    void RecordRead(UInt32 inRecord, UInt64 inOffset, UInt64 inSizeBytes);
+
+    // in first touch order
+    void GetRecords(std::vector<ResourceAccessRecord> &outRecords);
+
+    // one "firstTouch offset size location" line per record that was read from
+    bool Save(const std::string &inLocation);
+    static bool Load(const std::string &inLocation, std::vector<ResourceAccessRecord> &outRecords);
+
+private:
+    std::mutex mutex;
+    std::chrono::steady_clock::time_point start;
+    double maxSeconds;
+    std::vector<ResourceAccessRecord> records;
+    std::unordered_map<std::string, UInt32> recordIds;
+};
+
+// forwards to the io returned by a ResourceDirectory and reports every read to a trace
+class ResourceIoTraced : public ResourceIo {
+public:
+    ResourceIoTraced(const std::shared_ptr<ResourceIo> &inIo, ResourceAccessTrace *inTrace, UInt32 inRecord) 
+        : io(inIo), trace(inTrace), record(inRecord) {}
+
+    AsyncResult<Int> Read(void *outBuffer, UInt inSizeBytes);
+    AsyncResult<Int> Write(const void *inBuffer, UInt inSizeBytes) { return io->Write(inBuffer, inSizeBytes); }
+    bool Seek(UInt inOffset, Int32 inOrigin) { return io->Seek(inOffset, inOrigin); }
+    Int Tell() const { return io->Tell(); }
+    bool IsWritable() const { return io->IsWritable(); }
+    bool IsSeekable() const { return io->IsSeekable(); }
+    const void *Map(UInt &outSizeBytes);
+    bool IsMapTerminated() const { return io->IsMapTerminated(); }
+
+private:
+    std::shared_ptr<ResourceIo> io;
+    ResourceAccessTrace *trace;
+    UInt32 record;
+};
+
+/*
+ * Warms the OS file cache with the files of a previous run's access trace: every range is
+ * first handed to the kernel as a readahead hint, then read through in first touch order
+ */
+class ResourcePrefetcher {
+public:
+    ResourcePrefetcher();
+    ~ResourcePrefetcher(); // stops and waits for the workers
+
+    void Start(ResourceDirectory &inDir, const std::vector<ResourceAccessRecord> &inRecords, UInt32 inNumThreads);
+    // abandons whatever has not been prefetched yet
+    void Stop();
+    bool IsDone() const { return numFinished == workers.size(); }
+
+private:
+    void WorkerMain();
+
+private:
+    std::vector<std::thread> workers;
+    std::vector<ResourceAccessRecord> records;
+    ResourceDirectory *dir;
+    std::atomic<UInt32> nextHint;
+    std::atomic<UInt32> nextRead;
+    std::atomic<UInt32> numFinished;
+    std::atomic<bool> quit;
+};
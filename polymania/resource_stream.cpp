@@ -0,0 +1,104 @@
+#include <memory>
+#include <unordered_map>
+#include <list>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "types.hpp"
+#include "asyncmodel.hpp"
+#include "resource.hpp"
+#include "resource_stream.hpp"
+
+ResourceStreamer::ResourceStreamer(UInt32 inNumWorkers) : pendingDirty(false), nextSequence(0), quit(false) {
+    for(UInt32 i = 0; i < inNumWorkers; ++i) {
+        workers.push_back(std::thread(&ResourceStreamer::WorkerMain, this));
+    }
+}
+
+ResourceStreamer::~ResourceStreamer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for(auto it = workers.begin(); it != workers.end(); ++it) {
+        it->join();
+    }
+
+    // nobody will adopt these anymore
+    for(auto it = completed.begin(); it != completed.end(); ++it) {
+        if((*it)->loaded) {
+            (*it)->cache->Discard((*it)->loaded);
+            (*it)->loaded = 0;
+        }
+    }
+}
+
+bool ResourceStreamer::ComparePriority(const RequestPtr &a, const RequestPtr &b) {
+    Int32 pa = a->priority, pb = b->priority;
+    if(pa != pb) return pa < pb;
+    return a->sequence > b->sequence;
+}
+
+void ResourceStreamer::Enqueue(const RequestPtr &inRequest) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        inRequest->streamer = this;
+        inRequest->sequence = nextSequence++;
+        pending.push_back(inRequest);
+        if(!pendingDirty) std::push_heap(pending.begin(), pending.end(), &ComparePriority);
+    }
+    wake.notify_one();
+}
+
+void ResourceStreamer::SetPriority(ResourceRequestState &inRequest, Int32 inPriority) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(inRequest.priority != inPriority) {
+        inRequest.priority = inPriority;
+        pendingDirty = true;
+    }
+}
+
+void ResourceStreamer::PopCompleted(std::vector<RequestPtr> &outCompleted) {
+    std::lock_guard<std::mutex> lock(mutex);
+    outCompleted.insert(outCompleted.end(), completed.begin(), completed.end());
+    completed.clear();
+}
+
+void ResourceStreamer::WaitCompleted() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while(!quit && completed.empty()) completedWake.wait(lock);
+}
+
+void ResourceStreamer::WorkerMain() {
+    for(;;) {
+        RequestPtr request;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while(!quit && pending.empty()) wake.wait(lock);
+            if(quit) return;
+
+            if(pendingDirty) {
+                std::make_heap(pending.begin(), pending.end(), &ComparePriority);
+                pendingDirty = false;
+            }
+            std::pop_heap(pending.begin(), pending.end(), &ComparePriority);
+            request = pending.back();
+            pending.pop_back();
+            request->status = ResourceRequest::STATUS_Loading;
+        }
+
+        Resource *res = request->cache->LoadDetached(request->location);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        request->loaded = res;
+        request->status = res ? ResourceRequest::STATUS_Loaded : ResourceRequest::STATUS_Failed;
+        completed.push_back(request);
+        completedWake.notify_all();
+    }
+}
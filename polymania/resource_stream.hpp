@@ -0,0 +1,52 @@
+#pragma once
+
+struct ResourceRequestState {
+    std::string location;
+    ResourceCache *cache;
+    ResourceStreamer *streamer;
+    std::atomic<Int32> priority;
+    std::atomic<Int32> status;
+    UInt64 sequence; // keeps equal priorities in submission order
+    Resource *loaded; // detached resource produced by a worker, owned by the request until adopted
+    ResourceHandle handle;
+
+    ResourceRequestState(const std::string &inLocation, ResourceCache *inCache, Int32 inPriority)
+        : location(inLocation), cache(inCache), streamer(0), priority(inPriority), status(ResourceRequest::STATUS_Queued), sequence(0), loaded(0) {}
+};
+
+/*
+ * Worker pool loading queued requests in priority order
+ */
+class ResourceStreamer {
+public:
+    typedef std::shared_ptr<ResourceRequestState> RequestPtr;
+
+public:
+    ResourceStreamer(UInt32 inNumWorkers);
+    ~ResourceStreamer();
+
+    void Enqueue(const RequestPtr &inRequest);
+    void SetPriority(ResourceRequestState &inRequest, Int32 inPriority);
+
+    // moves requests whose Load has finished on a worker to outCompleted
+    void PopCompleted(std::vector<RequestPtr> &outCompleted);
+    // blocks until at least one request is waiting to be popped
+    void WaitCompleted();
+
+    static bool ComparePriority(const RequestPtr &a, const RequestPtr &b);
+
+private:
+    void WorkerMain();
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable completedWake;
+
+    std::vector<RequestPtr> pending; // max-heap on priority
+    bool pendingDirty; // a priority changed, the heap must be rebuilt
+    std::vector<RequestPtr> completed;
+    UInt64 nextSequence;
+    bool quit;
+};
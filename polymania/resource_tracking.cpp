@@ -0,0 +1,195 @@
+#include <cstdlib>
+#include <memory>
+#include <unordered_map>
+#include <list>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <atomic>
+#include <mutex>
+
+#include "types.hpp"
+#include "asyncmodel.hpp"
+#include "resource.hpp"
+#include "resource_tracking.hpp"
+
+static bool CompareCurrentBytes(const ResourceMemoryCategoryStats &a, const ResourceMemoryCategoryStats &b) {
+    return a.currentBytes > b.currentBytes;
+}
+
+ResourceMemoryAllocatorTracking::ResourceMemoryAllocatorTracking(ResourceMemoryAllocator *inBacking) 
+    : backing(inBacking), currentBytes(0), peakBytes(0), totalAllocations(0) {
+    categories.push_back(ResourceMemoryCategoryStats());
+    categories.back().name = "untagged";
+    categoryIds[categories.back().name] = 0;
+    locations.push_back(std::string());
+}
+
+ResourceMemoryAllocatorTracking::~ResourceMemoryAllocatorTracking() {
+    ReportLeaks();
+}
+
+void *ResourceMemoryAllocatorTracking::Allocate(UInt inSizeBytes, UInt32 inAlignment) {
+    void *ptr = backing->Allocate(inSizeBytes, inAlignment);
+    if(!ptr) return 0;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    UInt32 category, location;
+    TagLocked(category, location);
+    TrackLocked(ptr, inSizeBytes, category, location);
+    return ptr;
+}
+
+void *ResourceMemoryAllocatorTracking::Reallocate(void *inPtr, UInt inSize, UInt32 inAlignment) {
+    // untracked before the backing call frees inPtr, once it does another thread's Allocate may get
+    // the address back and its record must not be taken for this one. A resized block stays with
+    // whoever allocated it
+    UInt32 category, location;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = inPtr ? live.find(inPtr) : live.end();
+        if(it != live.end()) {
+            category = it->second.category;
+            location = it->second.location;
+            UntrackLocked(it);
+        } else {
+            TagLocked(category, location);
+        }
+    }
+
+    void *ptr = backing->Reallocate(inPtr, inSize, inAlignment);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // on failure inPtr may or may not have been freed, it stays untracked and a later Free finds no record
+    if(ptr) TrackLocked(ptr, inSize, category, location);
+    return ptr;
+}
+
+void ResourceMemoryAllocatorTracking::Free(void *inPtr) {
+    if(!inPtr) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = live.find(inPtr);
+        if(it != live.end()) UntrackLocked(it);
+    }
+    backing->Free(inPtr);
+}
+
+bool ResourceMemoryAllocatorTracking::Reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(!backing->Reset()) return false;
+
+    live.clear();
+    currentBytes = 0;
+    for(auto it = categories.begin(); it != categories.end(); ++it) {
+        it->currentBytes = 0;
+        it->numAllocations = 0;
+    }
+    return true;
+}
+
+void ResourceMemoryAllocatorTracking::TagLocked(UInt32 &outCategory, UInt32 &outLocation) {
+    outCategory = 0;
+    outLocation = 0;
+    const ResourceMemoryTag *tag = ResourceMemoryTag::GetCurrent();
+    if(!tag) return;
+
+    auto itCategory = categoryIds.find(tag->GetCategory());
+    if(itCategory == categoryIds.end()) {
+        outCategory = UInt32(categories.size());
+        categories.push_back(ResourceMemoryCategoryStats());
+        categories.back().name = tag->GetCategory();
+        categoryIds[categories.back().name] = outCategory;
+    } else {
+        outCategory = itCategory->second;
+    }
+
+    if(!tag->GetLocation()) return;
+    auto itLocation = locationIds.find(*tag->GetLocation());
+    if(itLocation == locationIds.end()) {
+        outLocation = UInt32(locations.size());
+        locations.push_back(*tag->GetLocation());
+        locationIds[locations.back()] = outLocation;
+    } else {
+        outLocation = itLocation->second;
+    }
+}
+
+void ResourceMemoryAllocatorTracking::TrackLocked(void *inPtr, UInt inSizeBytes, UInt32 inCategory, UInt32 inLocation) {
+    Record &record = live[inPtr];
+    record.size = inSizeBytes;
+    record.category = inCategory;
+    record.location = inLocation;
+
+    ResourceMemoryCategoryStats &stats = categories[inCategory];
+    stats.currentBytes += inSizeBytes;
+    stats.peakBytes = std::max(stats.peakBytes, stats.currentBytes);
+    stats.numAllocations++;
+    stats.totalAllocations++;
+
+    currentBytes += inSizeBytes;
+    peakBytes = std::max(peakBytes, currentBytes);
+    totalAllocations++;
+}
+
+void ResourceMemoryAllocatorTracking::UntrackLocked(std::unordered_map<void*, Record>::iterator inIt) {
+    ResourceMemoryCategoryStats &stats = categories[inIt->second.category];
+    stats.currentBytes -= inIt->second.size;
+    stats.numAllocations--;
+    currentBytes -= inIt->second.size;
+    live.erase(inIt);
+}
+
+void ResourceMemoryAllocatorTracking::GetSnapshot(ResourceMemorySnapshot &outSnapshot) {
+    std::lock_guard<std::mutex> lock(mutex);
+    outSnapshot.currentBytes = currentBytes;
+    outSnapshot.peakBytes = peakBytes;
+    outSnapshot.numAllocations = UInt32(live.size());
+    outSnapshot.totalAllocations = totalAllocations;
+    outSnapshot.categories = categories;
+    std::stable_sort(outSnapshot.categories.begin(), outSnapshot.categories.end(), &CompareCurrentBytes);
+}
+
+void ResourceMemoryAllocatorTracking::PrintStats() {
+    ResourceMemorySnapshot s;
+    GetSnapshot(s);
+
+    std::cout << "Resource memory: " << std::endl;
+    for(auto it = s.categories.begin(); it != s.categories.end(); ++it) {
+        std::cout << 
+            it->name << ": "
+            "current=" << it->currentBytes << " "
+            "peak=" << it->peakBytes << " "
+            "allocs=" << it->numAllocations << " "
+            "total=" << it->totalAllocations << std::endl;
+    }
+    std::cout << 
+        "current=" << s.currentBytes << " "
+        "peak=" << s.peakBytes << " "
+        "allocs=" << s.numAllocations << " "
+        "total=" << s.totalAllocations << std::endl;
+    std::cout << std::endl;
+}
+
+UInt32 ResourceMemoryAllocatorTracking::ReportLeaks() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(live.empty()) return 0;
+
+    // (category, location) -> (bytes, count)
+    std::unordered_map<UInt64, std::pair<UInt, UInt32>> leaks;
+    for(auto it = live.begin(); it != live.end(); ++it) {
+        std::pair<UInt, UInt32> &leak = leaks[(UInt64(it->second.category) << 32) | it->second.location];
+        leak.first += it->second.size;
+        leak.second++;
+    }
+
+    std::cerr << "Resource memory leaked: " << currentBytes << " bytes in " << live.size() << " allocations" << std::endl;
+    for(auto it = leaks.begin(); it != leaks.end(); ++it) {
+        const std::string &location = locations[UInt32(it->first)];
+        std::cerr << "    " << categories[UInt32(it->first >> 32)].name << " "
+            << (location.empty() ? "<no location>" : location) << ": "
+            << it->second.first << " bytes in " << it->second.second << " allocations" << std::endl;
+    }
+    return UInt32(live.size());
+}
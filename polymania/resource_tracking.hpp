@@ -0,0 +1,68 @@
+#pragma once
+
+struct ResourceMemoryCategoryStats {
+    std::string name; // ResourceMemoryTag category, "untagged" for allocations made outside of any tag
+    UInt currentBytes;
+    UInt peakBytes;
+    UInt32 numAllocations; // currently live
+    UInt64 totalAllocations;
+
+    ResourceMemoryCategoryStats() : currentBytes(0), peakBytes(0), numAllocations(0), totalAllocations(0) {}
+};
+
+struct ResourceMemorySnapshot {
+    UInt currentBytes;
+    UInt peakBytes;
+    UInt32 numAllocations;
+    UInt64 totalAllocations;
+    std::vector<ResourceMemoryCategoryStats> categories; // largest current usage first
+
+    ResourceMemorySnapshot() : currentBytes(0), peakBytes(0), numAllocations(0), totalAllocations(0) {}
+};
+
+/*
+ * Wraps another allocator and accounts every allocation to the ResourceMemoryTag
+ * that was active on the allocating thread, whatever is still live on destruction is reported as leaked
+ */
+class ResourceMemoryAllocatorTracking : public ResourceMemoryAllocator {
+public:
+    ResourceMemoryAllocatorTracking(ResourceMemoryAllocator *inBacking);
+    ~ResourceMemoryAllocatorTracking();
+
+    void *Allocate(UInt inSizeBytes, UInt32 inAlignment);
+    void *Reallocate(void *inPtr, UInt inSize, UInt32 inAlignment);
+    void Free(void *inPtr);
+    bool Reset();
+
+    ResourceMemoryAllocator *GetBacking() const { return backing; }
+
+    void GetSnapshot(ResourceMemorySnapshot &outSnapshot);
+    void PrintStats();
+    // prints every live allocation grouped by location, returns how many there are
+    UInt32 ReportLeaks();
+
+private:
+    struct Record {
+        UInt size;
+        UInt32 category;
+        UInt32 location; // index into locations, 0 when the tag had none
+    };
+
+    void TrackLocked(void *inPtr, UInt inSizeBytes, UInt32 inCategory, UInt32 inLocation);
+    void UntrackLocked(std::unordered_map<void*, Record>::iterator inIt);
+    void TagLocked(UInt32 &outCategory, UInt32 &outLocation);
+
+private:
+    std::mutex mutex;
+    ResourceMemoryAllocator *backing;
+    std::unordered_map<void*, Record> live;
+
+    std::vector<ResourceMemoryCategoryStats> categories;
+    std::unordered_map<std::string, UInt32> categoryIds;
+    std::vector<std::string> locations;
+    std::unordered_map<std::string, UInt32> locationIds;
+
+    UInt currentBytes;
+    UInt peakBytes;
+    UInt64 totalAllocations;
+};
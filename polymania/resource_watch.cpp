@@ -0,0 +1,111 @@
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+
+#ifndef __arm__
+#include <libuv/uv.h>
+#endif
+
+#include <memory>
+#include <unordered_map>
+#include <list>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+
+#include "types.hpp"
+#include "asyncmodel.hpp"
+#include "resource.hpp"
+#include "resource_watch.hpp"
+
+// the Raspberry Pi build does not link libuv, hot reload is only available on desktop
+#ifndef __arm__
+
+struct ResourceWatcher::Directory {
+    uv_fs_event_t handle;
+    std::string path; // prefix of the locations inside, empty for the working directory
+    ResourceWatcher *owner;
+    bool active;
+};
+
+ResourceWatcher::ResourceWatcher(double inDebounceSeconds) 
+    : loop(uv_loop_new()), 
+      debounce(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(inDebounceSeconds))) {
+}
+
+ResourceWatcher::~ResourceWatcher() {
+    for(auto it = directories.begin(); it != directories.end(); ++it) {
+        if(it->second->active) uv_close((uv_handle_t*)&it->second->handle, 0);
+    }
+    // lets the loop finish closing the handles before their memory goes away
+    uv_run(loop, UV_RUN_DEFAULT);
+    uv_loop_delete(loop);
+}
+
+void ResourceWatcher::Watch(const std::string &inLocation) {
+    size_t slash = inLocation.find_last_of("/\\");
+    std::string path = slash == std::string::npos ? std::string() : inLocation.substr(0, slash);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if(directories.find(path) != directories.end()) return;
+
+    auto dir = std::make_shared<Directory>();
+    dir->path = path;
+    dir->owner = this;
+    dir->handle.data = dir.get();
+    // watching the directory rather than the file survives editors that save by renaming over it
+    dir->active = uv_fs_event_init(loop, &dir->handle, path.empty() ? "." : path.c_str(), &OnEvent, 0) == 0;
+    if(!dir->active) {
+        std::cerr << "Could not watch resource directory: " << (path.empty() ? "." : path) << std::endl;
+    }
+    directories[path] = dir;
+}
+
+void ResourceWatcher::Poll(std::vector<std::string> &outChanged) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uv_run(loop, UV_RUN_NOWAIT);
+    if(changed.empty()) return;
+
+    auto now = std::chrono::steady_clock::now();
+    for(auto it = changed.begin(); it != changed.end();) {
+        if(now - it->second >= debounce) {
+            outChanged.push_back(it->first);
+            it = changed.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ResourceWatcher::OnEvent(uv_fs_event_t *inHandle, const char *inFilename, int inEvents, int inStatus) {
+    if(inStatus != 0 || !inFilename) return;
+
+    // called from uv_run inside Poll, the owner's mutex is already held
+    Directory *dir = (Directory*)inHandle->data;
+    std::string location = dir->path.empty() ? std::string(inFilename) : dir->path + "/" + inFilename;
+    dir->owner->changed[location] = std::chrono::steady_clock::now();
+}
+
+#else
+
+struct ResourceWatcher::Directory {
+};
+
+ResourceWatcher::ResourceWatcher(double inDebounceSeconds) : loop(0) {
+}
+
+ResourceWatcher::~ResourceWatcher() {
+}
+
+void ResourceWatcher::Watch(const std::string &inLocation) {
+}
+
+void ResourceWatcher::Poll(std::vector<std::string> &outChanged) {
+}
+
+void ResourceWatcher::OnEvent(uv_fs_event_s *inHandle, const char *inFilename, int inEvents, int inStatus) {
+}
+
+#endif
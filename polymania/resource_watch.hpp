@@ -0,0 +1,31 @@
+#pragma once
+
+struct uv_loop_s;
+struct uv_fs_event_s;
+
+/*
+ * Watches the directories of loaded resources and reports changed locations
+ * once no further events arrived for the debounce interval
+ */
+class ResourceWatcher {
+public:
+    ResourceWatcher(double inDebounceSeconds);
+    ~ResourceWatcher();
+
+    // starts watching the directory containing inLocation, cheap if it is already watched
+    void Watch(const std::string &inLocation);
+    // dispatches pending file system events without blocking and returns the locations that settled
+    void Poll(std::vector<std::string> &outChanged);
+
+private:
+    struct Directory;
+
+    static void OnEvent(uv_fs_event_s *inHandle, const char *inFilename, int inEvents, int inStatus);
+
+private:
+    std::mutex mutex;
+    uv_loop_s *loop;
+    std::unordered_map<std::string, std::shared_ptr<Directory>> directories;
+    std::unordered_map<std::string, std::chrono::steady_clock::time_point> changed; // location -> last event
+    std::chrono::steady_clock::duration debounce;
+};
@@ -1,5 +1,6 @@
 #ifdef __arm__
 #include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
 #include <EGL/egl.h>
 #define GLFW_INCLUDE_ES2
 #else
@@ -10,9 +11,13 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <cstring>
+#include <cstddef>
 #include <vector>
 #include <string>
 #include <unordered_map>
+#include <list>
+#include <atomic>
+#include <mutex>
 #include <iostream>
 #include <fstream>
 #include <memory>
@@ -20,7 +25,12 @@
 #include "types.hpp"
 #include "asyncmodel.hpp"
 #include "resource.hpp"
+#include "render_upload.hpp"
+#include "vertex_layout.hpp"
 #include "shader.hpp"
+#include "render_list.hpp"
+#include "render_state.hpp"
+#include "render_vao.hpp"
 
 
 ///////////////////////////////////////////////////////////
@@ -55,27 +65,159 @@ const char *fheader = "#version 130\n"
 //////////////////////////////////////////////////////////////////////////
 // Implmentation
 
-bool Shader::blendEnabled = false;
+static const VertexAttribute vertexAttributes[] = {
+    VERTEX_ATTRIBUTE_ARRAY(Vertex, x, 3, "in_Position", false),
+    VERTEX_ATTRIBUTE_ARRAY(Vertex, r, 4, "in_Color", true)
+};
+DEFINE_VERTEX_LAYOUT(Vertex, vertexAttributes)
 
-RenderBatcher::RenderBatcher( UInt32 vertsPerBatch) : shader(0), vboId(0), vertsPerBatch(vertsPerBatch), nVerts(0) {
+static GLenum GetBufferUsage(RenderBatcher::UsageHint hintUsage) {
+    switch(hintUsage) {
+        case RenderBatcher::USAGE_Stream:
+            return GL_STREAM_DRAW;
+        case RenderBatcher::USAGE_Dynamic:
+            return GL_DYNAMIC_DRAW;
+        case RenderBatcher::USAGE_Static:
+            return GL_STATIC_DRAW;
+        default:
+            return GL_DYNAMIC_DRAW;
+    }
+}
+
+RenderBatcher::RenderBatcher( UInt32 vertsPerBatch) : shader(0), layout(&GetVertexLayout<Vertex>()), vboId(0), vertsPerBatch(vertsPerBatch), nVerts(0), nUploaded(0),
+                                                         iboId(0), nIndices(0), indexSize(0),
+                                                         uploadQueue(0), uploadTicket(0), nUploading(0),
+                                                         streamId(0), streamSize(0), streamHead(0), streamSynced(false), streamFirst(0), streamCount(0), streamFenced(false) {
     verts.resize(vertsPerBatch);
     glGenBuffers(1, &vboId);
 }
 
 RenderBatcher::~RenderBatcher() {
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glDeleteBuffers(1, &vboId);
+    CancelUpload();
+    RenderState::DeleteBuffer(vboId);
+    RenderState::DeleteBuffer(iboId);
+#ifndef __arm__
+    for(auto it = streamFences.begin(); it != streamFences.end(); ++it) {
+        glDeleteSync((GLsync)it->fence);
+    }
+#endif
+    RenderState::DeleteBuffer(streamId);
 }
 
 void RenderBatcher::SetShader(const Shader &s) {
     shader = &s;
-    glBindBuffer(GL_ARRAY_BUFFER, vboId);
-    Int32 posIdx = shader->GetAttributeLocation("in_Position");
-    Int32 colorIdx = shader->GetAttributeLocation("in_Color");
-    glEnableVertexAttribArray(posIdx); //pos
-    glEnableVertexAttribArray(colorIdx); //color
-    glVertexAttribPointer(posIdx, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
-    glVertexAttribPointer(colorIdx, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)(3*sizeof(float)));
+}
+
+void RenderBatcher::SetLayout(const VertexLayout &inLayout) {
+    layout = &inLayout;
+}
+
+static GLenum GetComponentType(VertexComponentType inType) {
+    switch(inType) {
+        case VERTEX_Float:
+            return GL_FLOAT;
+#ifdef __arm__
+        case VERTEX_Half:
+            return GL_HALF_FLOAT_OES;
+#else
+        case VERTEX_Half:
+            return GL_HALF_FLOAT;
+        case VERTEX_Int2_10_10_10:
+            return GL_INT_2_10_10_10_REV;
+        case VERTEX_UInt2_10_10_10:
+            return GL_UNSIGNED_INT_2_10_10_10_REV;
+#endif
+        case VERTEX_Int8:
+            return GL_BYTE;
+        case VERTEX_UInt8:
+            return GL_UNSIGNED_BYTE;
+        case VERTEX_Int16:
+            return GL_SHORT;
+        case VERTEX_UInt16:
+            return GL_UNSIGNED_SHORT;
+        default:
+            return GL_FLOAT;
+    }
+}
+
+bool RenderBatcher::IsLayoutSupported(const VertexLayout &inLayout) {
+    for(UInt32 i = 0; i < inLayout.numAttributes; ++i) {
+        switch(inLayout.attributes[i].type) {
+#ifdef __arm__
+            case VERTEX_Half: {
+                const char *extensions = (const char*)glGetString(GL_EXTENSIONS);
+                if(!extensions || !std::strstr(extensions, "GL_OES_vertex_half_float")) return false;
+                break;
+            }
+            case VERTEX_Int2_10_10_10:
+            case VERTEX_UInt2_10_10_10:
+                // OES_vertex_type_10_10_10_2 packs the other way around
+                return false;
+#else
+            case VERTEX_Half:
+                if(!GLEW_VERSION_3_0 && !GLEW_ARB_half_float_vertex) return false;
+                break;
+            case VERTEX_Int2_10_10_10:
+            case VERTEX_UInt2_10_10_10:
+                if(!GLEW_VERSION_3_3 && !GLEW_ARB_vertex_type_2_10_10_10_rev) return false;
+                break;
+#endif
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+static const VertexAttribute *FindAttribute(const VertexLayout *inLayout, const std::string &inName) {
+    if(!inLayout) return 0;
+    for(UInt32 i = 0; i < inLayout->numAttributes; ++i) {
+        if(inName == inLayout->attributes[i].name) return &inLayout->attributes[i];
+    }
+    return 0;
+}
+
+#ifndef __arm__
+// set once any attribute was made per instance, only then do the others need resetting
+static bool divisorsUsed = false;
+
+static void SetAttributeDivisor(UInt32 inLocation, UInt32 inDivisor) {
+    if(!inDivisor && !divisorsUsed) return;
+    divisorsUsed = true;
+    if(GLEW_VERSION_3_3) glVertexAttribDivisor(inLocation, inDivisor);
+    else glVertexAttribDivisorARB(inLocation, inDivisor);
+}
+#endif
+
+void RenderBatcher::SetVertexPointers(const Shader &inShader, UInt32 inBufferId, const VertexLayout &inLayout,
+                                      UInt32 inInstanceBufferId, const VertexLayout *inInstanceLayout) {
+    for(auto it = inShader.attributes.begin(); it != inShader.attributes.end(); ++it) {
+        Int32 location = it->second.location;
+        if(location < 0) continue; // built in
+
+        const VertexLayout *layout = &inLayout;
+        UInt32 bufferId = inBufferId;
+        const VertexAttribute *attribute = FindAttribute(layout, it->first);
+        if(!attribute) {
+            layout = inInstanceLayout;
+            bufferId = inInstanceBufferId;
+            attribute = FindAttribute(layout, it->first);
+        }
+        if(!attribute) {
+            // the shader reads the attribute's constant value instead of stale pointers
+            RenderState::SetVertexAttribArray(location, false);
+            continue;
+        }
+        RenderState::BindBuffer(GL_ARRAY_BUFFER, bufferId);
+        RenderState::SetVertexAttribArray(location, true);
+        glVertexAttribPointer(location, attribute->components, GetComponentType(attribute->type), attribute->normalized ? GL_TRUE : GL_FALSE,
+                              layout->stride, (const void*)UInt(attribute->offset));
+#ifndef __arm__
+        SetAttributeDivisor(location, layout == &inLayout ? 0 : 1);
+#endif
+    }
+    // callers upload into the vertex buffer next
+    RenderState::BindBuffer(GL_ARRAY_BUFFER, inBufferId);
 }
 void RenderBatcher::Queue(float x, float y, float z, UInt8 r, UInt8 g, UInt8 b, UInt8 a) {
     auto &v = verts[nVerts];
@@ -110,26 +252,138 @@ void RenderBatcher::Clear() {
 }
 
 void RenderBatcher::Upload(UsageHint hintUsage) {
-    GLenum hint;
-    switch(hintUsage) {
-        case USAGE_Stream:
-            hint = GL_STREAM_DRAW;
-            break;
-        case USAGE_Dynamic:
-            hint = GL_DYNAMIC_DRAW;
-            break;
-        case USAGE_Static:
-            hint = GL_STATIC_DRAW;
-            break;
-        default:
-            hint = GL_DYNAMIC_DRAW;
+    Upload(&verts[0], nVerts, hintUsage);
+}
+
+void RenderBatcher::Upload(const Vertex *inVertices, UInt32 inNumVertices, UsageHint hintUsage) {
+    CancelUpload();
+    SetLayout(GetVertexLayout<Vertex>());
+    if(streamId) {
+        StreamUpload(inVertices, inNumVertices);
+        return;
+    }
+    // a draw list or another batcher may have left a different buffer bound
+    RenderState::BindBuffer(GL_ARRAY_BUFFER, vboId);
+    glBufferData(GL_ARRAY_BUFFER, inNumVertices*sizeof(Vertex), inVertices, GetBufferUsage(hintUsage));
+    nUploaded = inNumVertices;
+}
+
+bool RenderBatcher::UploadVertices(const void *inVertices, UInt32 inNumVertices, const VertexLayout &inLayout, UsageHint hintUsage) {
+    if(&inLayout == &GetVertexLayout<Vertex>()) {
+        Upload((const Vertex*)inVertices, inNumVertices, hintUsage);
+        return true;
     }
-    glBufferData(GL_ARRAY_BUFFER, nVerts*sizeof(Vertex), &verts[0], hint);
+    if(streamId || !IsLayoutSupported(inLayout)) {
+        std::cerr << "Vertex layout not supported" << (streamId ? " while streaming" : "") << std::endl;
+        return false;
+    }
+    CancelUpload();
+    SetLayout(inLayout);
+    RenderState::BindBuffer(GL_ARRAY_BUFFER, vboId);
+    glBufferData(GL_ARRAY_BUFFER, UInt(inNumVertices)*inLayout.stride, inVertices, GetBufferUsage(hintUsage));
+    nUploaded = inNumVertices;
+    return true;
+}
+
+void RenderBatcher::Upload(RenderUploadQueue &ioQueue, const Vertex *inVertices, UInt32 inNumVertices, const ResourceHandle &inOwner, UsageHint hintUsage) {
+    CancelUpload();
+    SetLayout(GetVertexLayout<Vertex>());
+    nUploaded = 0;
+    nUploading = inNumVertices;
+    uploadQueue = &ioQueue;
+    uploadTicket = ioQueue.Enqueue(vboId, inVertices, inNumVertices*sizeof(Vertex), GetBufferUsage(hintUsage), inOwner, &OnUploaded, this);
+}
+
+void RenderBatcher::CancelUpload() {
+    if(uploadQueue) uploadQueue->Cancel(uploadTicket);
+    uploadQueue = 0;
+    uploadTicket = 0;
+}
+
+void RenderBatcher::OnUploaded(void *inUserData, UInt32 inTicket) {
+    RenderBatcher *self = (RenderBatcher*)inUserData;
+    if(inTicket != self->uploadTicket) return;
+    self->nUploaded = self->nUploading;
+    self->uploadQueue = 0;
+    self->uploadTicket = 0;
+}
+
+UInt32 RenderBatcher::GetIndexType(UInt32 inIndexSize) {
+    return inIndexSize == 4 ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+}
+
+bool RenderBatcher::SupportsIndices32() {
+#ifdef __arm__
+    static Int32 supported = -1;
+    if(supported < 0) {
+        const char *extensions = (const char*)glGetString(GL_EXTENSIONS);
+        supported = extensions && std::strstr(extensions, "GL_OES_element_index_uint") ? 1 : 0;
+    }
+    return supported != 0;
+#else
+    return true;
+#endif
+}
+
+bool RenderBatcher::UploadIndices(const UInt32 *inIndices, UInt32 inNumIndices, UsageHint hintUsage) {
+    UInt32 maxIndex = 0;
+    for(UInt32 i = 0; i < inNumIndices; ++i) {
+        if(inIndices[i] > maxIndex) maxIndex = inIndices[i];
+    }
+    if(maxIndex > 0xFFFF) return UploadIndices((const void*)inIndices, inNumIndices, 4, hintUsage);
+
+    // half the index bandwidth whenever the vertices can be addressed with 16 bits
+    std::vector<UInt16> packed(inIndices, inIndices + inNumIndices);
+    return UploadIndices(packed.empty() ? 0 : (const void*)&packed[0], inNumIndices, 2, hintUsage);
+}
+
+bool RenderBatcher::UploadIndices(const void *inIndices, UInt32 inNumIndices, UInt32 inIndexSize, UsageHint hintUsage) {
+    if(inIndexSize != 2 && (inIndexSize != 4 || !SupportsIndices32())) {
+        std::cerr << "Unsupported index size " << inIndexSize << std::endl;
+        ClearIndices();
+        return false;
+    }
+    if(!iboId) glGenBuffers(1, &iboId);
+    RenderVaoCache::BindDefault();
+    RenderState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboId);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, UInt(inNumIndices)*inIndexSize, inIndices, GetBufferUsage(hintUsage));
+    nIndices = inNumIndices;
+    indexSize = inIndexSize;
+    return true;
+}
+
+void RenderBatcher::ClearIndices() {
+    nIndices = 0;
 }
 
 void RenderBatcher::Draw() {
-    glDrawArrays(GL_TRIANGLES, 0, Int32(nVerts));
+    if(!shader) return;
+    if(streamId) {
+        RenderVaoCache::Bind(*shader, streamId, *layout);
+        StreamDraw();
+        return;
+    }
+    if(nIndices) {
+        // the indices refer to vertices that may still be on their way through the upload queue
+        if(!nUploaded) return;
+        RenderVaoCache::Bind(*shader, vboId, *layout, iboId);
+        glDrawElements(GL_TRIANGLES, Int32(nIndices), GetIndexType(indexSize), 0);
+        return;
+    }
+    RenderVaoCache::Bind(*shader, vboId, *layout);
+    glDrawArrays(GL_TRIANGLES, 0, Int32(nUploaded));
+}
+void RenderBatcher::Submit(RenderDrawList &ioList, UInt32 inLayer, float inDepth, Shader::BlendFunc inBlend) const {
+    if(!shader) return;
+    if(streamId) {
+        if(streamCount) ioList.Submit(inLayer, inDepth, *shader, inBlend, streamId, *layout, streamFirst, streamCount);
+    } else if(nIndices) {
+        if(nUploaded) ioList.SubmitIndexed(inLayer, inDepth, *shader, inBlend, vboId, *layout, iboId, indexSize, 0, Int32(nIndices));
+    } else if(nUploaded) {
+        ioList.Submit(inLayer, inDepth, *shader, inBlend, vboId, *layout, 0, Int32(nUploaded));
+    }
 }
+
 void RenderBatcher::UploadDraw(bool clear) {
     
     Upload(USAGE_Stream);
@@ -141,6 +395,102 @@ void RenderBatcher::UpsizeBatch() {
     verts.resize(verts.size() + vertsPerBatch);
 }
 
+void RenderBatcher::EnableStreaming(UInt32 inRingVertices) {
+    if(streamId || !inRingVertices) return;
+
+#ifdef __arm__
+    streamSynced = false;
+#else
+    streamSynced = (GLEW_VERSION_3_2 || GLEW_ARB_sync) && (GLEW_VERSION_3_0 || GLEW_ARB_map_buffer_range);
+#endif
+    streamSize = inRingVertices*sizeof(Vertex);
+    streamHead = 0;
+    glGenBuffers(1, &streamId);
+    RenderState::BindBuffer(GL_ARRAY_BUFFER, streamId);
+    glBufferData(GL_ARRAY_BUFFER, streamSize, 0, GL_STREAM_DRAW);
+}
+
+void RenderBatcher::StreamUpload(const Vertex *inVertices, UInt32 inNumVertices) {
+    // the previous range went out through a draw list, its fence lands behind that draw
+    FenceStreamRange();
+    RenderState::BindBuffer(GL_ARRAY_BUFFER, streamId);
+
+    UInt bytes = inNumVertices*sizeof(Vertex);
+    if(bytes > streamSize) {
+        // an upload never wraps, so the ring grows to hold it, the old storage is orphaned with its fences
+        streamSize = bytes;
+        glBufferData(GL_ARRAY_BUFFER, streamSize, 0, GL_STREAM_DRAW);
+#ifndef __arm__
+        for(auto it = streamFences.begin(); it != streamFences.end(); ++it) {
+            glDeleteSync((GLsync)it->fence);
+        }
+#endif
+        streamFences.clear();
+        streamHead = 0;
+    } else if(streamHead + bytes > streamSize) {
+        streamHead = 0;
+        // fresh storage from the driver while the GPU keeps reading the old one
+        if(!streamSynced) glBufferData(GL_ARRAY_BUFFER, streamSize, 0, GL_STREAM_DRAW);
+    }
+
+#ifndef __arm__
+    if(streamSynced) {
+        WaitStreamRange(streamHead, streamHead + bytes);
+        void *ring = bytes ? glMapBufferRange(GL_ARRAY_BUFFER, streamHead, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT) : 0;
+        if(ring) {
+            std::memcpy(ring, inVertices, bytes);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+    } else
+#endif
+    {
+        glBufferSubData(GL_ARRAY_BUFFER, streamHead, bytes, inVertices);
+    }
+
+    streamFirst = Int32(streamHead/sizeof(Vertex));
+    streamCount = Int32(inNumVertices);
+    streamFenced = false;
+    streamHead += bytes;
+}
+
+void RenderBatcher::StreamDraw() {
+    if(!streamCount) return;
+    glDrawArrays(GL_TRIANGLES, streamFirst, streamCount);
+    FenceStreamRange();
+}
+
+void RenderBatcher::FenceStreamRange() {
+#ifndef __arm__
+    if(streamSynced && streamCount && !streamFenced) {
+        // the range may be overwritten once the GPU is past the commands issued so far
+        StreamFence fence;
+        fence.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        fence.begin = UInt(streamFirst)*sizeof(Vertex);
+        fence.end = fence.begin + UInt(streamCount)*sizeof(Vertex);
+        streamFences.push_back(fence);
+        streamFenced = true;
+    }
+#endif
+}
+
+void RenderBatcher::WaitStreamRange(UInt inBegin, UInt inEnd) {
+#ifndef __arm__
+    for(auto it = streamFences.begin(); it != streamFences.end();) {
+        GLsync fence = (GLsync)it->fence;
+        bool overlaps = it->begin < inEnd && inBegin < it->end;
+        if(overlaps) {
+            // only reached when the ring is too small for the frames in flight
+            while(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+        } else if(glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            ++it;
+            continue;
+        }
+        glDeleteSync(fence);
+        it = streamFences.erase(it);
+    }
+#endif
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 Shader::Shader() : progId(0) {
@@ -149,20 +499,23 @@ Shader::Shader() : progId(0) {
 
 Shader::~Shader() {
     Detach();
+    RenderVaoCache::ForgetProgram(progId);
     if(progId > 0) glDeleteProgram(progId);
 }
 
 bool Shader::Initialize(const std::string &vertshader, const std::string &fragshader, bool useProg) {
-    UInt32 vshaderId, fshaderId;
-
-    progId = glCreateProgram();
-    vshaderId = glCreateShader(GL_VERTEX_SHADER);
-    fshaderId = glCreateShader(GL_FRAGMENT_SHADER);
+    UInt32 vshaderId, fshaderId, newProgId;
 
     if(vertshader.empty() || fragshader.empty()) {
         std::cerr << "Failed to load shader" << std::endl;
         return false;
     }
+
+    // build into a new program so a failed re-initialize keeps the working one
+    newProgId = glCreateProgram();
+    vshaderId = glCreateShader(GL_VERTEX_SHADER);
+    fshaderId = glCreateShader(GL_FRAGMENT_SHADER);
+
     const char *vertSource[] = {vheader, vertshader.c_str()};
     const char *fragSource[] = {fheader, fragshader.c_str()};
 
@@ -175,31 +528,47 @@ bool Shader::Initialize(const std::string &vertshader, const std::string &fragsh
     glGetShaderiv(vshaderId, GL_COMPILE_STATUS, &compiled);
     if (!compiled) {
         std::cerr << "Failed to compile vertshader" << std::endl;
+        glDeleteShader(vshaderId);
+        glDeleteShader(fshaderId);
+        glDeleteProgram(newProgId);
         return false;
     }
     glGetShaderiv(fshaderId, GL_COMPILE_STATUS, &compiled);
     if (!compiled) {
         std::cerr << "Failed to compile fragshader" << std::endl;
+        glDeleteShader(vshaderId);
+        glDeleteShader(fshaderId);
+        glDeleteProgram(newProgId);
         return false;
     }
 
-    glAttachShader(progId, vshaderId);
-    glAttachShader(progId, fshaderId);
+    glAttachShader(newProgId, vshaderId);
+    glAttachShader(newProgId, fshaderId);
 
 #ifndef __arm__
-    glBindFragDataLocation(progId, 0, "out_FragColor");
+    glBindFragDataLocation(newProgId, 0, "out_FragColor");
 #endif
 
-    glLinkProgram(progId);
+    glLinkProgram(newProgId);
+
+    // flagged for deletion, they go away together with the program
+    glDeleteShader(vshaderId);
+    glDeleteShader(fshaderId);
 
-    glGetProgramiv(progId, GL_LINK_STATUS, &linked);
+    glGetProgramiv(newProgId, GL_LINK_STATUS, &linked);
     if (!linked) {
         std::cerr << "Failed to link prog" << std::endl;
+        glDeleteProgram(newProgId);
         return false;
     }
 
+    RenderVaoCache::ForgetProgram(progId);
+    if(progId > 0) glDeleteProgram(progId);
+    progId = newProgId;
+
     uniforms.clear();
     attributes.clear();
+    uniformValues.clear();
 
     Int32 uniformMaxLen=0, activeUniforms=0;
     glGetProgramiv(progId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &uniformMaxLen);
@@ -216,7 +585,12 @@ bool Shader::Initialize(const std::string &vertshader, const std::string &fragsh
             u.size = size;
             u.type = type;
             u.location = glGetUniformLocation(progId, u.name.c_str());
+            u.handle = Int32(uniformValues.size());
             uniforms[u.name] = u;
+
+            UniformValue value;
+            value.location = u.location;
+            uniformValues.push_back(value);
         }
     }
 
@@ -239,16 +613,13 @@ bool Shader::Initialize(const std::string &vertshader, const std::string &fragsh
         }
     }
 
-    glDeleteShader(vshaderId);
-    glDeleteShader(fshaderId);
-
-    if(useProg) glUseProgram(progId);
+    if(useProg) RenderState::UseProgram(progId);
 
     return true;
 }
 
 void Shader::Attach() {
-    glUseProgram(progId);
+    RenderState::UseProgram(progId);
 }
 
 void Shader::PrintInfo() {
@@ -281,6 +652,27 @@ Int32 Shader::GetUniformLocation( const std::string &name ) const {
     else return -1;
 }
 
+ShaderUniform Shader::GetUniform(const std::string &name) const {
+    auto it = uniforms.find(name);
+    if(it != uniforms.end()) return ShaderUniform(it->second.handle);
+    else return ShaderUniform();
+}
+
+void Shader::InvalidateUniforms() {
+    for(auto it = uniformValues.begin(); it != uniformValues.end(); ++it) {
+        it->bytes.clear();
+    }
+}
+
+bool Shader::UpdateValue(Int32 inHandle, const void *inValue, UInt32 inBytes) const {
+    if(inHandle < 0 || UInt32(inHandle) >= uniformValues.size()) return false;
+    std::vector<UInt8> &bytes = uniformValues[inHandle].bytes;
+    if(bytes.size() == inBytes && (!inBytes || memcmp(&bytes[0], inValue, inBytes) == 0)) return false;
+    bytes.assign((const UInt8*)inValue, (const UInt8*)inValue + inBytes);
+    RenderState::UseProgram(progId);
+    return true;
+}
+
 Int32 Shader::GetAttributeLocation( const std::string &name ) const {
     auto it = attributes.find(name);
     if(it != attributes.end()) return it->second.location;
@@ -386,62 +778,17 @@ void Shader::SetUniform(Int32 loc, const glm::ivec4 &xyzw) {
 }
 
 void Shader::Detach() {
-    glUseProgram(0);
+    RenderState::UseProgram(0);
 }
 
 void Shader::SetBlendFunc(BlendFunc inBlend) {
-    if(inBlend != BLEND_None) {
-        if(!blendEnabled) {
-            glEnable(GL_BLEND);
-            blendEnabled = true;
-        }
-    }
     switch(inBlend) {
         case BLEND_None:
-            glDisable(GL_BLEND);
-            blendEnabled = false;
+            RenderState::SetBlend(false);
             break;
         case BLEND_Transparent:
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            RenderState::SetBlend(true);
+            RenderState::SetBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
             break;
     }
 }
-
-bool ResourceShader::Load( ResourceMemoryAllocator &inAllocator, ResourceDirectory &inDir ) {
-    allocator = &inAllocator;
-
-    auto res = ResourceDirectory::instance->Open(GetLocation(), ResourceDirectory::PERMISSION_ReadOnly);
-    auto resIo = res.GetResult();
-
-    if(!resIo) return false;
-
-    Int size = 0;
-    Int realSize = 0;
-    Int bytesRead;
-
-    const Int increment = 1024;
-    do {
-        size += increment;
-        string = (char*)allocator->Reallocate(string, size+1);
-        
-        bytesRead = resIo->Read(string+size-increment, increment).GetResult();
-        realSize += bytesRead;
-
-        if(bytesRead < increment) break;
-    } while(true);
-
-    string = (char*)allocator->Reallocate(string, realSize+1);
-    string[realSize] = 0;
-
-    return true;
-}
-
-bool ResourceShader::Unload() {
-    if(allocator && string) {
-        allocator->Free(string);
-        string = 0;
-        return true;
-    } else {
-        return false;
-    }
-}
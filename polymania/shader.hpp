@@ -1,17 +1,33 @@
 #pragma once
 
+class RenderUploadQueue;
+class RenderDrawList;
+
 #define DEFAULT_VERTICES_PER_BATCH 1000
+#define DEFAULT_STREAM_RING_VERTICES (1024*1024)
 
 struct Vertex {
     float x, y, z;
     UInt8 r,g,b,a; // Native GL format, RGBA 32bits
 };
 
+DECLARE_VERTEX_LAYOUT(Vertex);
+
 struct UniformDescription {
     std::string name;
     Int32 location;
     UInt32 type;
     Int32 size;
+    Int32 handle; // see ShaderUniform
+};
+
+// a uniform looked up once by Shader::GetUniform instead of by name on every write, valid until the
+// shader is initialized again
+struct ShaderUniform {
+    Int32 handle; // -1 if the shader has no such uniform, writes are dropped
+
+    ShaderUniform() : handle(-1) {}
+    explicit ShaderUniform(Int32 inHandle) : handle(inHandle) {}
 };
 
 struct AttributeDescription {
@@ -42,27 +58,42 @@ public:
     };
 
 private:
+    // with a shader the value is compared to what was last sent and the GL call skipped when it is the same,
+    // a changed value attaches the shader's program before it is sent
     struct UniformProxy {
+        const Shader *shader; // null to write straight to the location
         Int32 uniformLocation;
-
-        UniformProxy(Int32 uniformLocation) : uniformLocation(uniformLocation) {}
+        Int32 handle;
+
+        UniformProxy(Int32 uniformLocation) : shader(0), uniformLocation(uniformLocation), handle(-1) {}
+        // a handle the shader does not have (e.g. from before it was initialized again) is dropped like -1
+        UniformProxy(const Shader *shader, Int32 handle) : shader(shader), uniformLocation(-1), handle(-1) {
+            if(handle >= 0 && UInt32(handle) < shader->uniformValues.size()) {
+                uniformLocation = shader->uniformValues[handle].location;
+                this->handle = handle;
+            }
+        }
 
         template<typename T>
         UniformProxy &operator=(const T val) {
-            SetUniform(uniformLocation, val);
+            if(!shader || shader->UpdateValue(handle, &val, sizeof(T))) SetUniform(uniformLocation, val);
             return *this;
         }
         template<typename T>
         UniformProxy &operator=(const UniformArray<T> &val) {
-            SetUniform(uniformLocation, val.base, val.size);
+            if(!shader || shader->UpdateValue(handle, val.base, sizeof(T)*val.size)) SetUniform(uniformLocation, val.base, val.size);
             return *this;
         }
     };
 
+    struct UniformValue {
+        Int32 location;
+        std::vector<UInt8> bytes; // last sent, empty until the first write
+    };
+
 public:
     static void Detach();
     static void SetBlendFunc(BlendFunc inBlend);
-    static bool blendEnabled;
 
 public:
     Shader();
@@ -74,11 +105,20 @@ public:
     void PrintInfo();
     Int32 GetUniformLocation(const std::string &name) const;
     Int32 GetAttributeLocation(const std::string &name) const;
+    ShaderUniform GetUniform(const std::string &name) const;
+    // forgets the values last sent, for when the program's uniforms were written around this shader
+    void InvalidateUniforms();
 
+    // the writes go to this shader's program, which stays attached afterwards
     UniformProxy operator[](const std::string &name) const {
-        return UniformProxy(GetUniformLocation(name));
+        return UniformProxy(this, GetUniform(name).handle);
+    }
+
+    UniformProxy operator[](ShaderUniform inUniform) const {
+        return UniformProxy(this, inUniform.handle);
     }
 
+    // not compared to the last value and not remembered either, the writes go to the attached program
     UniformProxy operator[](Int32 inUniformLocation) const {
         return UniformProxy(inUniformLocation);
     }
@@ -126,6 +166,14 @@ public:
     UInt32 progId;
     std::unordered_map<std::string, UniformDescription> uniforms;
     std::unordered_map<std::string, AttributeDescription> attributes;
+
+private:
+    // false if inHandle is -1 or out of range or already holds inBytes of inValue, otherwise remembers them
+    // and attaches the program so the caller's glUniform reaches it
+    bool UpdateValue(Int32 inHandle, const void *inValue, UInt32 inBytes) const;
+
+private:
+    mutable std::vector<UniformValue> uniformValues; // indexed by ShaderUniform handles
 };
 
 class RenderBatcher {
@@ -142,34 +190,96 @@ public:
 
 public:
     void SetShader(const Shader &);
+    // what the uploaded vertices look like, the Upload overloads set it from their vertex type
+    void SetLayout(const VertexLayout &inLayout);
+    const VertexLayout &GetLayout() const { return *layout; }
     void Queue(float x, float y, float z, UInt8 r, UInt8 g, UInt8 b, UInt8 a=255);
     void Queue(const Vertex *inVertices, UInt32 inNumVertices);
     void Clear();
     void Upload(UsageHint hintUsage=USAGE_Stream);
+    // fills the buffer straight from inVertices (e.g. a mapped ResourceMesh), the queued vertices are left alone
+    void Upload(const Vertex *inVertices, UInt32 inNumVertices, UsageHint hintUsage=USAGE_Static);
+    // any vertex type with a layout (see DEFINE_VERTEX_LAYOUT), only Vertex data is streamed
+    template<typename T>
+    bool Upload(const T *inVertices, UInt32 inNumVertices, UsageHint hintUsage=USAGE_Static) {
+        return UploadVertices(inVertices, inNumVertices, GetVertexLayout<T>(), hintUsage);
+    }
+    bool UploadVertices(const void *inVertices, UInt32 inNumVertices, const VertexLayout &inLayout, UsageHint hintUsage=USAGE_Static);
+    // same through the upload queue, Draw draws nothing until the queue reports the vertices resident
+    void Upload(RenderUploadQueue &ioQueue, const Vertex *inVertices, UInt32 inNumVertices, const ResourceHandle &inOwner, UsageHint hintUsage=USAGE_Static);
+    // indices into the uploaded vertices, Draw then draws them with glDrawElements until ClearIndices. They are
+    // stored as 16 bits whenever every index fits, false if 32 bits are needed and the GL cannot draw them
+    bool UploadIndices(const UInt32 *inIndices, UInt32 inNumIndices, UsageHint hintUsage=USAGE_Static);
+    // already packed into inIndexSize (2 or 4) bytes each, e.g. the indices of a ResourceMesh
+    bool UploadIndices(const void *inIndices, UInt32 inNumIndices, UInt32 inIndexSize, UsageHint hintUsage=USAGE_Static);
+    void ClearIndices();
+    bool IsIndexed() const { return nIndices != 0; }
     void Draw();
     void UploadDraw(bool hintClear=true);
+    // queues what Draw would draw into ioList instead, to be sorted with everything else submitted this frame
+    void Submit(RenderDrawList &ioList, UInt32 inLayer, float inDepth, Shader::BlendFunc inBlend) const;
+
+    // uploads append to a ring of inRingVertices and draws use their offset into it, nothing is re-specified
+    // or waited on unless the ring wraps onto vertices the GPU has not drawn yet, it grows for bigger uploads.
+    // Indices are not used while streaming
+    void EnableStreaming(UInt32 inRingVertices=DEFAULT_STREAM_RING_VERTICES);
+    bool IsStreaming() const { return streamId != 0; }
+
+    // binds inBufferId and points the shader's inputs at the attributes of inLayout in it, those of
+    // inInstanceLayout are read once per instance from inInstanceBufferId
+    static void SetVertexPointers(const Shader &inShader, UInt32 inBufferId, const VertexLayout &inLayout,
+                                  UInt32 inInstanceBufferId=0, const VertexLayout *inInstanceLayout=0);
+    // false if the GL cannot read one of the component types, e.g. half floats on GLES2 without OES_vertex_half_float
+    static bool IsLayoutSupported(const VertexLayout &inLayout);
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT for 2 or 4 byte indices
+    static UInt32 GetIndexType(UInt32 inIndexSize);
+    static bool SupportsIndices32();
 
 private:
+    struct StreamFence {
+        void *fence; // GLsync
+        UInt begin, end;
+    };
+
     void UpsizeBatch();
+    void StreamUpload(const Vertex *inVertices, UInt32 inNumVertices);
+    void StreamDraw();
+    void FenceStreamRange();
+    void WaitStreamRange(UInt inBegin, UInt inEnd);
+    void CancelUpload();
+    static void OnUploaded(void *inUserData, UInt32 inTicket);
 
 private:
     const Shader *shader;
+    const VertexLayout *layout;
     UInt32 vboId;
     UInt32 vertsPerBatch;
 
     std::vector<Vertex> verts;
     UInt32 nVerts;
+    UInt32 nUploaded; // vertices in the buffer, what Draw draws
+
+    UInt32 iboId; // created by the first UploadIndices
+    UInt32 nIndices;
+    UInt32 indexSize;
+
+    RenderUploadQueue *uploadQueue; // set while a queued upload is outstanding
+    UInt32 uploadTicket;
+    UInt32 nUploading;
+
+    UInt32 streamId; // ring buffer, 0 unless streaming
+    UInt streamSize;
+    UInt streamHead; // bytes
+    bool streamSynced; // fences and unsynchronized mapping, otherwise the ring is orphaned when it wraps
+    Int32 streamFirst, streamCount; // vertices written by the last upload, drawn by Draw
+    bool streamFenced; // a fence already follows the draw of that range
+    std::list<StreamFence> streamFences;
 };
 
-class ResourceShader : public Resource {
+class ResourceShader : public ResourceBlob {
 public:
-    ResourceShader() : string(0), allocator(0) {}
-    bool Load(ResourceMemoryAllocator &inAllocator, ResourceDirectory &inDir);
-    bool Unload();
+    ResourceShader() : ResourceBlob(BLOB_Terminated | BLOB_Shared) {}
 
-public:
-    char *string;
-
-private:
-    ResourceMemoryAllocator *allocator;
+    const char *GetString() const { return (const char*)data; }
+    UInt GetLength() const { return size; }
 };
@@ -0,0 +1,352 @@
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+#include "types.hpp"
+#include "render_cull.hpp"
+#include "spatial_tree.hpp"
+
+static const UInt32 NO_NODE = ~0u;
+static const UInt32 ALL_PLANES = (1u << RenderFrustum::NUM_PLANES) - 1;
+
+// half the surface area, all the heuristic needs to compare splits
+static inline float HalfArea(const glm::vec3 &inMin, const glm::vec3 &inMax) {
+    glm::vec3 size = inMax - inMin;
+    return size.x*size.y + size.y*size.z + size.z*size.x;
+}
+
+static inline bool TouchesVolume(const glm::vec3 &inMin, const glm::vec3 &inMax, const glm::vec3 &inQueryMin, const glm::vec3 &inQueryMax, float inRadius) {
+    if(inMax.x < inQueryMin.x || inMin.x > inQueryMax.x || inMax.y < inQueryMin.y || inMin.y > inQueryMax.y ||
+       inMax.z < inQueryMin.z || inMin.z > inQueryMax.z) return false;
+    if(inRadius < 0.0f) return true;
+    // distance from the sphere's center to the closest point of the box
+    glm::vec3 center = (inQueryMin + inQueryMax)*0.5f;
+    glm::vec3 offset = center - glm::clamp(center, inMin, inMax);
+    return glm::dot(offset, offset) <= inRadius*inRadius;
+}
+
+SpatialTree::SpatialTree() {
+}
+
+SpatialTree::~SpatialTree() {
+}
+
+UInt32 SpatialTree::Insert(const glm::vec3 &inMin, const glm::vec3 &inMax) {
+    UInt32 handle;
+    if(!freeHandles.empty()) {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    } else {
+        handle = UInt32(objects.size());
+        objects.resize(objects.size() + 1);
+    }
+    Object &object = objects[handle];
+    object.min = inMin;
+    object.max = inMax;
+    object.leaf = NO_NODE;
+    object.slot = UInt32(pending.size());
+    object.removed = false;
+    pending.push_back(handle);
+    pendingBounds.AddBox(inMin, inMax);
+    return handle;
+}
+
+void SpatialTree::Update(UInt32 inHandle, const glm::vec3 &inMin, const glm::vec3 &inMax) {
+    Object &object = objects[inHandle];
+    object.min = inMin;
+    object.max = inMax;
+    if(object.leaf != NO_NODE) {
+        leafBounds.SetBox(object.slot, inMin, inMax);
+        MarkDirty(object.leaf);
+    } else if(!object.removed) {
+        pendingBounds.SetBox(object.slot, inMin, inMax);
+    }
+}
+
+void SpatialTree::Remove(UInt32 inHandle) {
+    Object &object = objects[inHandle];
+    if(object.removed) return;
+    object.removed = true;
+    if(object.leaf == NO_NODE) {
+        // never made it into the tree, the last pending object takes its place
+        UInt32 moved = pending.back();
+        pending[object.slot] = moved;
+        objects[moved].slot = object.slot;
+        pending.pop_back();
+        pendingBounds.Remove(object.slot);
+        freeHandles.push_back(inHandle);
+    } else {
+        removedHandles.push_back(inHandle);
+    }
+}
+
+void SpatialTree::Clear() {
+    objects.clear();
+    order.clear();
+    nodes.clear();
+    pending.clear();
+    leafBounds.Clear();
+    pendingBounds.Clear();
+    freeHandles.clear();
+    removedHandles.clear();
+}
+
+void SpatialTree::MarkDirty(UInt32 inNode) {
+    while(inNode != NO_NODE && !nodes[inNode].dirty) {
+        nodes[inNode].dirty = true;
+        inNode = nodes[inNode].parent;
+    }
+}
+
+void SpatialTree::Build() {
+    freeHandles.insert(freeHandles.end(), removedHandles.begin(), removedHandles.end());
+    removedHandles.clear();
+    pending.clear();
+    pendingBounds.Clear();
+    leafBounds.Clear();
+
+    std::vector<BuildItem> items;
+    items.reserve(objects.size());
+    for(UInt32 i = 0; i < UInt32(objects.size()); ++i) {
+        Object &object = objects[i];
+        object.leaf = NO_NODE;
+        if(object.removed) continue;
+        BuildItem item;
+        item.min = object.min;
+        item.max = object.max;
+        item.center = (object.min + object.max)*0.5f;
+        item.handle = i;
+        items.push_back(item);
+    }
+
+    order.resize(items.size());
+    nodes.clear();
+    if(items.empty()) return;
+    nodes.reserve(items.size()/SPATIAL_TREE_LEAF_SIZE*2 + 1);
+    nodes.resize(1);
+    nodes[0].parent = NO_NODE;
+    BuildNode(0, 0, UInt32(items.size()), items);
+
+    for(UInt32 i = 0; i < UInt32(order.size()); ++i) {
+        Object &object = objects[order[i]];
+        object.slot = i;
+        leafBounds.AddBox(object.min, object.max);
+    }
+}
+
+void SpatialTree::BuildNode(UInt32 inNode, UInt32 inFirst, UInt32 inCount, std::vector<BuildItem> &ioItems) {
+    glm::vec3 boundsMin = ioItems[inFirst].min, boundsMax = ioItems[inFirst].max;
+    glm::vec3 centerMin = ioItems[inFirst].center, centerMax = ioItems[inFirst].center;
+    for(UInt32 i = inFirst + 1; i < inFirst + inCount; ++i) {
+        const BuildItem &item = ioItems[i];
+        boundsMin = glm::min(boundsMin, item.min);
+        boundsMax = glm::max(boundsMax, item.max);
+        centerMin = glm::min(centerMin, item.center);
+        centerMax = glm::max(centerMax, item.center);
+    }
+
+    Node &node = nodes[inNode];
+    node.min = boundsMin;
+    node.max = boundsMax;
+    node.first = inFirst;
+    node.count = inCount;
+    node.left = 0;
+    node.dirty = false;
+
+    if(inCount <= SPATIAL_TREE_LEAF_SIZE) {
+        for(UInt32 i = inFirst; i < inFirst + inCount; ++i) {
+            order[i] = ioItems[i].handle;
+            objects[order[i]].leaf = inNode;
+        }
+        return;
+    }
+
+    // sort the centers into bins along each axis and keep the split with the least area times objects on either side
+    Int32 bestAxis = -1;
+    UInt32 bestBin = 0;
+    float bestCost = 0.0f;
+    for(Int32 axis = 0; axis < 3; ++axis) {
+        float extent = centerMax[axis] - centerMin[axis];
+        if(extent <= 0.0f) continue;
+        float scale = SPATIAL_TREE_BINS/extent;
+
+        UInt32 binCount[SPATIAL_TREE_BINS] = {0};
+        glm::vec3 binMin[SPATIAL_TREE_BINS], binMax[SPATIAL_TREE_BINS];
+        for(UInt32 i = inFirst; i < inFirst + inCount; ++i) {
+            const BuildItem &item = ioItems[i];
+            UInt32 bin = std::min(UInt32((item.center[axis] - centerMin[axis])*scale), UInt32(SPATIAL_TREE_BINS - 1));
+            if(binCount[bin]++) {
+                binMin[bin] = glm::min(binMin[bin], item.min);
+                binMax[bin] = glm::max(binMax[bin], item.max);
+            } else {
+                binMin[bin] = item.min;
+                binMax[bin] = item.max;
+            }
+        }
+
+        // the cost of everything left of each split, swept from the left, then added to from the right
+        float leftCost[SPATIAL_TREE_BINS];
+        UInt32 count = 0;
+        glm::vec3 sweepMin, sweepMax;
+        for(UInt32 b = 0; b < SPATIAL_TREE_BINS - 1; ++b) {
+            if(binCount[b]) {
+                sweepMin = count ? glm::min(sweepMin, binMin[b]) : binMin[b];
+                sweepMax = count ? glm::max(sweepMax, binMax[b]) : binMax[b];
+                count += binCount[b];
+            }
+            leftCost[b] = count ? HalfArea(sweepMin, sweepMax)*count : 0.0f;
+        }
+        count = 0;
+        for(UInt32 b = SPATIAL_TREE_BINS - 1; b > 0; --b) {
+            if(binCount[b]) {
+                sweepMin = count ? glm::min(sweepMin, binMin[b]) : binMin[b];
+                sweepMax = count ? glm::max(sweepMax, binMax[b]) : binMax[b];
+                count += binCount[b];
+            }
+            if(!count || count == inCount) continue;
+            float cost = leftCost[b - 1] + HalfArea(sweepMin, sweepMax)*count;
+            if(bestAxis < 0 || cost < bestCost) {
+                bestAxis = axis;
+                bestBin = b;
+                bestCost = cost;
+            }
+        }
+    }
+
+    UInt32 middle = inFirst + inCount/2;
+    if(bestAxis >= 0) {
+        float scale = SPATIAL_TREE_BINS/(centerMax[bestAxis] - centerMin[bestAxis]);
+        UInt32 i = inFirst, j = inFirst + inCount;
+        while(i < j) {
+            UInt32 bin = std::min(UInt32((ioItems[i].center[bestAxis] - centerMin[bestAxis])*scale), UInt32(SPATIAL_TREE_BINS - 1));
+            if(bin < bestBin) {
+                i++;
+            } else {
+                j--;
+                std::swap(ioItems[i], ioItems[j]);
+            }
+        }
+        middle = i;
+    }
+    // otherwise every center is the same point and the objects are just halved
+
+    UInt32 left = UInt32(nodes.size());
+    nodes.resize(nodes.size() + 2);
+    nodes[inNode].left = left;
+    nodes[left].parent = inNode;
+    nodes[left + 1].parent = inNode;
+    BuildNode(left, inFirst, middle - inFirst, ioItems);
+    BuildNode(left + 1, middle, inFirst + inCount - middle, ioItems);
+}
+
+void SpatialTree::Refit() {
+    if(!nodes.empty() && nodes[0].dirty) RefitNode(0);
+}
+
+void SpatialTree::RefitNode(UInt32 inNode) {
+    Node &node = nodes[inNode];
+    node.dirty = false;
+    if(node.left) {
+        if(nodes[node.left].dirty) RefitNode(node.left);
+        if(nodes[node.left + 1].dirty) RefitNode(node.left + 1);
+        node.min = glm::min(nodes[node.left].min, nodes[node.left + 1].min);
+        node.max = glm::max(nodes[node.left].max, nodes[node.left + 1].max);
+    } else {
+        node.min = objects[order[node.first]].min;
+        node.max = objects[order[node.first]].max;
+        for(UInt32 i = node.first + 1; i < node.first + node.count; ++i) {
+            node.min = glm::min(node.min, objects[order[i]].min);
+            node.max = glm::max(node.max, objects[order[i]].max);
+        }
+    }
+}
+
+void SpatialTree::EmitNode(const Node &inNode, std::vector<UInt32> &ioHandles) const {
+    for(UInt32 i = inNode.first; i < inNode.first + inNode.count; ++i) {
+        if(!objects[order[i]].removed) ioHandles.push_back(order[i]);
+    }
+}
+
+void SpatialTree::Cull(const RenderFrustum &inFrustum, std::vector<UInt32> &ioHandles) const {
+    if(!nodes.empty()) {
+        // leaves cut by the frustum, as ranges of order that are tested together once the walk is done
+        std::vector<UInt32> ranges;
+        // nodes still to visit, each with the planes its parent was not entirely inside of
+        std::vector<std::pair<UInt32, UInt32> > stack;
+        stack.reserve(64);
+        stack.push_back(std::make_pair(0u, ALL_PLANES));
+        while(!stack.empty()) {
+            const Node &node = nodes[stack.back().first];
+            UInt32 mask = stack.back().second;
+            stack.pop_back();
+
+            if(!inFrustum.ClipBox(node.min, node.max, mask)) continue;
+            if(!mask) {
+                EmitNode(node, ioHandles);
+            } else if(node.left) {
+                stack.push_back(std::make_pair(node.left + 1, mask));
+                stack.push_back(std::make_pair(node.left, mask));
+            } else if(!ranges.empty() && ranges.back() == node.first) {
+                // siblings follow each other in order, so neighbouring leaves join one range
+                ranges.back() += node.count;
+            } else {
+                ranges.push_back(node.first);
+                ranges.push_back(node.first + node.count);
+            }
+        }
+
+        // slots come back in place of handles, removed objects are still in the tree and dropped here
+        UInt first = ioHandles.size();
+        if(!ranges.empty()) leafBounds.CullRanges(inFrustum, &ranges[0], UInt32(ranges.size()/2), ioHandles);
+        UInt kept = first;
+        for(UInt i = first; i < ioHandles.size(); ++i) {
+            UInt32 handle = order[ioHandles[i]];
+            if(!objects[handle].removed) ioHandles[kept++] = handle;
+        }
+        ioHandles.resize(kept);
+    }
+
+    UInt first = ioHandles.size();
+    pendingBounds.Cull(inFrustum, ioHandles);
+    for(UInt i = first; i < ioHandles.size(); ++i) {
+        ioHandles[i] = pending[ioHandles[i]];
+    }
+}
+
+void SpatialTree::QueryBox(const glm::vec3 &inMin, const glm::vec3 &inMax, std::vector<UInt32> &ioHandles) const {
+    Query(inMin, inMax, -1.0f, ioHandles);
+}
+
+void SpatialTree::QuerySphere(const glm::vec3 &inCenter, float inRadius, std::vector<UInt32> &ioHandles) const {
+    Query(inCenter - glm::vec3(inRadius), inCenter + glm::vec3(inRadius), inRadius, ioHandles);
+}
+
+void SpatialTree::Query(const glm::vec3 &inMin, const glm::vec3 &inMax, float inRadius, std::vector<UInt32> &ioHandles) const {
+    if(!nodes.empty()) {
+        std::vector<UInt32> stack;
+        stack.reserve(64);
+        stack.push_back(0);
+        while(!stack.empty()) {
+            const Node &node = nodes[stack.back()];
+            stack.pop_back();
+
+            if(!TouchesVolume(node.min, node.max, inMin, inMax, inRadius)) continue;
+            if(node.left) {
+                stack.push_back(node.left + 1);
+                stack.push_back(node.left);
+            } else {
+                for(UInt32 i = node.first; i < node.first + node.count; ++i) {
+                    const Object &object = objects[order[i]];
+                    if(!object.removed && TouchesVolume(object.min, object.max, inMin, inMax, inRadius)) ioHandles.push_back(order[i]);
+                }
+            }
+        }
+    }
+
+    for(auto it = pending.begin(); it != pending.end(); ++it) {
+        const Object &object = objects[*it];
+        if(TouchesVolume(object.min, object.max, inMin, inMax, inRadius)) ioHandles.push_back(*it);
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#define SPATIAL_TREE_LEAF_SIZE 4 // most objects a leaf holds after Build
+#define SPATIAL_TREE_BINS 16 // candidate splits per axis tried by the surface area heuristic
+
+/*
+ * Bounding volume hierarchy over object boxes, for frustum culling and gameplay proximity queries
+ *
+ * Build sorts every object into a tree with a binned surface area heuristic, meant for the static
+ * bulk of a world. Objects that move afterwards call Update and the tree is refitted on the next
+ * Refit, walking only the branches above them; the tree's shape is kept, so objects that drift far
+ * from where they were built make it slower until the next Build. Objects inserted after a Build
+ * are culled as a flat list until the next Build takes them in.
+ *
+ * Cull stops descending where a node is entirely inside or outside the frustum, so its cost follows
+ * the visible objects rather than the size of the world. The objects of leaves cut by the frustum and
+ * the pending ones are kept in RenderCullSets in tree order and tested four at a time with its SIMD
+ * kernel. Results are the handles returned by Insert.
+ */
+class SpatialTree {
+public:
+    SpatialTree();
+    ~SpatialTree();
+
+    // handles stay valid until Remove, removed handles are reused after the next Build
+    UInt32 Insert(const glm::vec3 &inMin, const glm::vec3 &inMax);
+    void Update(UInt32 inHandle, const glm::vec3 &inMin, const glm::vec3 &inMax);
+    void Remove(UInt32 inHandle);
+    void Clear();
+
+    // rebuilds the whole tree from the current bounds of every object
+    void Build();
+    // grows and shrinks the nodes above objects moved by Update, queries need it in between
+    void Refit();
+
+    // append the handles of the objects touching the volume to ioHandles
+    void Cull(const RenderFrustum &inFrustum, std::vector<UInt32> &ioHandles) const;
+    void QueryBox(const glm::vec3 &inMin, const glm::vec3 &inMax, std::vector<UInt32> &ioHandles) const;
+    void QuerySphere(const glm::vec3 &inCenter, float inRadius, std::vector<UInt32> &ioHandles) const;
+
+    const glm::vec3 &GetMin(UInt32 inHandle) const { return objects[inHandle].min; }
+    const glm::vec3 &GetMax(UInt32 inHandle) const { return objects[inHandle].max; }
+    UInt32 GetNumObjects() const { return UInt32(objects.size() - freeHandles.size() - removedHandles.size()); }
+    UInt32 GetNumNodes() const { return UInt32(nodes.size()); }
+
+private:
+    struct Object {
+        glm::vec3 min, max;
+        UInt32 leaf; // node holding it, NO_NODE while pending or removed
+        UInt32 slot; // index into order and leafBounds, or into pending and pendingBounds while pending
+        bool removed;
+    };
+
+    // a node covers order[first, first + count), its whole subtree, so a node entirely in view
+    // is emitted without visiting its children
+    struct Node {
+        glm::vec3 min, max;
+        UInt32 first, count;
+        UInt32 left; // right child follows it, 0 for a leaf
+        UInt32 parent;
+        bool dirty; // bounds below changed since the last Refit
+    };
+
+    // an object's bounds copied next to its handle, so Build sorts them without chasing handles
+    struct BuildItem {
+        glm::vec3 min, max, center;
+        UInt32 handle;
+    };
+
+    // fills in nodes[inNode] for ioItems[inFirst, inFirst + inCount), reordering them into order
+    void BuildNode(UInt32 inNode, UInt32 inFirst, UInt32 inCount, std::vector<BuildItem> &ioItems);
+    void RefitNode(UInt32 inNode);
+    void MarkDirty(UInt32 inNode);
+    void EmitNode(const Node &inNode, std::vector<UInt32> &ioHandles) const;
+    // the box inMin..inMax, or the sphere inside it with a inRadius of 0 or more
+    void Query(const glm::vec3 &inMin, const glm::vec3 &inMax, float inRadius, std::vector<UInt32> &ioHandles) const;
+
+private:
+    std::vector<Object> objects;
+    std::vector<UInt32> order; // object handles grouped by leaf
+    std::vector<Node> nodes; // the root is nodes[0]
+    std::vector<UInt32> pending; // inserted since the last Build
+    RenderCullSet leafBounds; // the bounds of order[i] at i
+    RenderCullSet pendingBounds; // the bounds of pending[i] at i
+    std::vector<UInt32> freeHandles; // removed before the last Build
+    std::vector<UInt32> removedHandles; // removed since the last Build, still in the tree
+};
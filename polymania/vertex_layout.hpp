@@ -0,0 +1,118 @@
+#pragma once
+
+enum VertexComponentType {
+    VERTEX_Float,
+    VERTEX_Half, // GLES2 needs OES_vertex_half_float
+    VERTEX_Int8,
+    VERTEX_UInt8,
+    VERTEX_Int16,
+    VERTEX_UInt16,
+    VERTEX_Int2_10_10_10, // four components in one UInt32, desktop GL 3.3 or ARB_vertex_type_2_10_10_10_rev
+    VERTEX_UInt2_10_10_10
+};
+
+struct VertexAttribute {
+    const char *name; // shader input, skipped by shaders that do not use it
+    VertexComponentType type;
+    Int32 components;
+    bool normalized; // integers are read as 0..1 (unsigned) or -1..1 (signed) instead of their value
+    UInt32 offset;
+};
+
+struct VertexLayout {
+    const VertexAttribute *attributes;
+    UInt32 numAttributes;
+    UInt32 stride;
+
+    VertexLayout(const VertexAttribute *inAttributes, UInt32 inNumAttributes, UInt32 inStride)
+        : attributes(inAttributes), numAttributes(inNumAttributes), stride(inStride) {}
+};
+
+// x in the low bits and w in the top two, the order GL's *_2_10_10_10_REV types read
+struct VertexUnorm2_10_10_10 {
+    UInt32 bits;
+};
+
+struct VertexSnorm2_10_10_10 {
+    UInt32 bits;
+};
+
+inline VertexUnorm2_10_10_10 PackUnorm2_10_10_10(const glm::vec4 &inValue) {
+    glm::vec4 v = glm::clamp(inValue, 0.0f, 1.0f);
+    VertexUnorm2_10_10_10 packed;
+    packed.bits = UInt32(v.x*1023.0f + 0.5f) | UInt32(v.y*1023.0f + 0.5f) << 10 | UInt32(v.z*1023.0f + 0.5f) << 20 | UInt32(v.w*3.0f + 0.5f) << 30;
+    return packed;
+}
+
+// e.g. normals, -1..1 per component
+inline VertexSnorm2_10_10_10 PackSnorm2_10_10_10(const glm::vec4 &inValue) {
+    glm::vec4 v = glm::clamp(inValue, -1.0f, 1.0f);
+    VertexSnorm2_10_10_10 packed;
+    packed.bits = (UInt32(Int32(glm::floor(v.x*511.0f + 0.5f))) & 0x3FF) | (UInt32(Int32(glm::floor(v.y*511.0f + 0.5f))) & 0x3FF) << 10 |
+                  (UInt32(Int32(glm::floor(v.z*511.0f + 0.5f))) & 0x3FF) << 20 | (UInt32(Int32(glm::floor(v.w + 0.5f))) & 0x3) << 30;
+    return packed;
+}
+
+/*
+ * What a member of a vertex struct holds, used by VERTEX_ATTRIBUTE to describe it. The glm half float
+ * and sized integer vectors are covered when glm/gtc/half_float.hpp and glm/gtc/type_precision.hpp
+ * are included before this header
+ */
+template<typename T> struct VertexComponentTraits;
+
+#define VERTEX_COMPONENT_TRAITS(T, inType, inComponents) \
+    template<> struct VertexComponentTraits<T> { static const VertexComponentType type = inType; static const Int32 components = inComponents; }
+
+VERTEX_COMPONENT_TRAITS(float, VERTEX_Float, 1);
+VERTEX_COMPONENT_TRAITS(glm::vec2, VERTEX_Float, 2);
+VERTEX_COMPONENT_TRAITS(glm::vec3, VERTEX_Float, 3);
+VERTEX_COMPONENT_TRAITS(glm::vec4, VERTEX_Float, 4);
+VERTEX_COMPONENT_TRAITS(Int8, VERTEX_Int8, 1);
+VERTEX_COMPONENT_TRAITS(UInt8, VERTEX_UInt8, 1);
+VERTEX_COMPONENT_TRAITS(Int16, VERTEX_Int16, 1);
+VERTEX_COMPONENT_TRAITS(UInt16, VERTEX_UInt16, 1);
+VERTEX_COMPONENT_TRAITS(VertexSnorm2_10_10_10, VERTEX_Int2_10_10_10, 4);
+VERTEX_COMPONENT_TRAITS(VertexUnorm2_10_10_10, VERTEX_UInt2_10_10_10, 4);
+
+#ifdef GLM_GTC_half_float
+VERTEX_COMPONENT_TRAITS(glm::half, VERTEX_Half, 1);
+VERTEX_COMPONENT_TRAITS(glm::hvec2, VERTEX_Half, 2);
+VERTEX_COMPONENT_TRAITS(glm::hvec3, VERTEX_Half, 3);
+VERTEX_COMPONENT_TRAITS(glm::hvec4, VERTEX_Half, 4);
+#endif
+
+#ifdef GLM_GTC_type_precision
+VERTEX_COMPONENT_TRAITS(glm::i8vec2, VERTEX_Int8, 2);
+VERTEX_COMPONENT_TRAITS(glm::i8vec4, VERTEX_Int8, 4);
+VERTEX_COMPONENT_TRAITS(glm::u8vec2, VERTEX_UInt8, 2);
+VERTEX_COMPONENT_TRAITS(glm::u8vec4, VERTEX_UInt8, 4);
+VERTEX_COMPONENT_TRAITS(glm::i16vec2, VERTEX_Int16, 2);
+VERTEX_COMPONENT_TRAITS(glm::i16vec3, VERTEX_Int16, 3);
+VERTEX_COMPONENT_TRAITS(glm::i16vec4, VERTEX_Int16, 4);
+VERTEX_COMPONENT_TRAITS(glm::u16vec2, VERTEX_UInt16, 2);
+VERTEX_COMPONENT_TRAITS(glm::u16vec4, VERTEX_UInt16, 4);
+#endif
+
+// an attribute stored in Struct::member, its type and component count follow from the member's type
+#define VERTEX_ATTRIBUTE(Struct, member, inName, inNormalized) \
+    { inName, VertexComponentTraits<decltype(((Struct*)0)->member)>::type, VertexComponentTraits<decltype(((Struct*)0)->member)>::components, \
+      inNormalized, UInt32(offsetof(Struct, member)) }
+
+// inComponents consecutive members of one type starting at Struct::member, e.g. x, y, z
+#define VERTEX_ATTRIBUTE_ARRAY(Struct, member, inComponents, inName, inNormalized) \
+    { inName, VertexComponentTraits<decltype(((Struct*)0)->member)>::type, inComponents, inNormalized, UInt32(offsetof(Struct, member)) }
+
+/*
+ * The layout of vertex type T, defined once per type with DEFINE_VERTEX_LAYOUT in a .cpp file and
+ * declared next to the type with DECLARE_VERTEX_LAYOUT
+ */
+template<typename T> const VertexLayout &GetVertexLayout();
+
+#define DECLARE_VERTEX_LAYOUT(T) \
+    template<> const VertexLayout &GetVertexLayout<T>()
+
+#define DEFINE_VERTEX_LAYOUT(T, inAttributes) \
+    template<> const VertexLayout &GetVertexLayout<T>() { \
+        static const VertexLayout layout(inAttributes, UInt32(sizeof(inAttributes)/sizeof(inAttributes[0])), UInt32(sizeof(T))); \
+        return layout; \
+    }
@@ -0,0 +1,189 @@
+//
+// Converts a text mesh description into the .msh format loaded by ResourceMesh
+//
+// usage: build_mesh [-u] [-c] [-q bits] <input.txt> <output.msh>
+//
+//   -u       keep the vertices and indices as written, otherwise identical vertices are merged into
+//            an indexed mesh and the triangles reordered for the post-transform vertex cache
+//   -c       compress with mesh_codec, loads need a decode pass but read a fraction of the bytes
+//   -q bits  with -c, quantize positions to a grid of 1 to 24 bits per axis over the bounds
+//
+// Input lines are "v x y z r g b a" for a vertex and "i a b c ..." for any number of indices,
+// '#' starts a comment. Indices are stored as 16 bits when every vertex can be addressed that way.
+// The output is written in the host's byte order, every target we ship on is little endian.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "../polymania/types.hpp"
+#include "../polymania/mesh_format.hpp"
+#include "../polymania/mesh_codec.hpp"
+#include "../polymania/mesh_optimize.hpp"
+
+struct MeshVertex {
+    float x, y, z;
+    UInt8 r, g, b, a;
+};
+
+static bool ParseMesh(std::FILE *fp, const char *inName, std::vector<MeshVertex> &outVertices, std::vector<UInt32> &outIndices) {
+    char line[1024];
+    int lineNumber = 0;
+    while(std::fgets(line, sizeof(line), fp)) {
+        lineNumber++;
+        char *comment = std::strchr(line, '#');
+        if(comment) *comment = 0;
+
+        char *cursor = line;
+        while(*cursor == ' ' || *cursor == '\t') cursor++;
+        if(*cursor == 'v' && (cursor[1] == ' ' || cursor[1] == '\t')) {
+            MeshVertex v;
+            unsigned r, g, b, a;
+            if(std::sscanf(cursor+1, "%f %f %f %u %u %u %u", &v.x, &v.y, &v.z, &r, &g, &b, &a) != 7 || r > 255 || g > 255 || b > 255 || a > 255) {
+                std::fprintf(stderr, "build_mesh: %s:%d: expected v x y z r g b a\n", inName, lineNumber);
+                return false;
+            }
+            v.r = UInt8(r);
+            v.g = UInt8(g);
+            v.b = UInt8(b);
+            v.a = UInt8(a);
+            outVertices.push_back(v);
+        } else if(*cursor == 'i' && (cursor[1] == ' ' || cursor[1] == '\t')) {
+            cursor++;
+            unsigned long index;
+            int consumed;
+            while(std::sscanf(cursor, "%lu%n", &index, &consumed) == 1) {
+                outIndices.push_back(UInt32(index));
+                cursor += consumed;
+            }
+        } else if(*cursor != 0 && *cursor != '\n' && *cursor != '\r') {
+            std::fprintf(stderr, "build_mesh: %s:%d: unknown line\n", inName, lineNumber);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    bool compress = false;
+    bool optimize = true;
+    UInt32 positionBits = 0;
+    int arg = 1;
+    for(; arg < argc && argv[arg][0] == '-'; ++arg) {
+        if(std::strcmp(argv[arg], "-u") == 0) {
+            optimize = false;
+        } else if(std::strcmp(argv[arg], "-c") == 0) {
+            compress = true;
+        } else if(std::strcmp(argv[arg], "-q") == 0 && arg+1 < argc) {
+            positionBits = UInt32(std::atoi(argv[++arg]));
+        } else {
+            break;
+        }
+    }
+    if(argc - arg != 2 || positionBits > 24 || (positionBits && !compress)) {
+        std::fprintf(stderr, "usage: %s [-u] [-c] [-q bits] <input.txt> <output.msh>\n", argv[0]);
+        return 1;
+    }
+    const char *inputName = argv[arg], *outputName = argv[arg+1];
+
+    std::FILE *in = std::fopen(inputName, "rb");
+    if(!in) {
+        std::fprintf(stderr, "build_mesh: could not read %s\n", inputName);
+        return 1;
+    }
+    std::vector<MeshVertex> vertices;
+    std::vector<UInt32> indices;
+    bool parsed = ParseMesh(in, inputName, vertices, indices);
+    std::fclose(in);
+    if(!parsed) return 1;
+
+    if(vertices.empty()) {
+        std::fprintf(stderr, "build_mesh: %s has no vertices\n", inputName);
+        return 1;
+    }
+    if((indices.empty() ? vertices.size() : indices.size()) % 3 != 0) {
+        std::fprintf(stderr, "build_mesh: %s is not made of whole triangles\n", inputName);
+        return 1;
+    }
+    for(size_t i = 0; i < indices.size(); ++i) {
+        if(indices[i] >= vertices.size()) {
+            std::fprintf(stderr, "build_mesh: index %u out of range\n", unsigned(indices[i]));
+            return 1;
+        }
+    }
+
+    if(optimize) {
+        std::vector<UInt8> uniqueVertices;
+        std::vector<UInt32> uniqueIndices;
+        UInt32 numUnique = MeshDeduplicateVertices(&vertices[0], UInt32(vertices.size()), sizeof(MeshVertex),
+                                                   indices.empty() ? 0 : &indices[0], UInt32(indices.size()), uniqueVertices, uniqueIndices);
+        MeshOptimizeVertexCache(&uniqueIndices[0], UInt32(uniqueIndices.size()), numUnique);
+        MeshOptimizeVertexFetch(&uniqueVertices[0], numUnique, sizeof(MeshVertex), &uniqueIndices[0], UInt32(uniqueIndices.size()));
+
+        vertices.resize(numUnique);
+        std::memcpy(&vertices[0], &uniqueVertices[0], uniqueVertices.size());
+        indices.swap(uniqueIndices);
+    }
+
+    MeshFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = MESH_FILE_MAGIC;
+    header.version = MESH_FILE_VERSION;
+    header.indexSize = indices.empty() ? 0 : (vertices.size() <= 0x10000 ? 2 : 4);
+    header.vertexSize = sizeof(MeshVertex);
+    header.numVertices = UInt32(vertices.size());
+    header.numIndices = UInt32(indices.size());
+    header.flags = compress ? MESH_FILE_FLAG_Compressed : 0;
+    header.boundsMin[0] = header.boundsMax[0] = vertices[0].x;
+    header.boundsMin[1] = header.boundsMax[1] = vertices[0].y;
+    header.boundsMin[2] = header.boundsMax[2] = vertices[0].z;
+    for(auto it = vertices.begin(); it != vertices.end(); ++it) {
+        header.boundsMin[0] = std::min(header.boundsMin[0], it->x);
+        header.boundsMin[1] = std::min(header.boundsMin[1], it->y);
+        header.boundsMin[2] = std::min(header.boundsMin[2], it->z);
+        header.boundsMax[0] = std::max(header.boundsMax[0], it->x);
+        header.boundsMax[1] = std::max(header.boundsMax[1], it->y);
+        header.boundsMax[2] = std::max(header.boundsMax[2], it->z);
+    }
+
+    std::FILE *out = std::fopen(outputName, "wb");
+    if(!out) {
+        std::fprintf(stderr, "build_mesh: could not write %s\n", outputName);
+        return 1;
+    }
+    std::fwrite(&header, sizeof(header), 1, out);
+    if(compress) {
+        std::vector<UInt8> encodedVertices, encodedIndices;
+        MeshEncodeVertices(&vertices[0], UInt32(vertices.size()), positionBits, header.boundsMin, header.boundsMax, encodedVertices);
+        MeshEncodeIndices(indices.empty() ? 0 : &indices[0], UInt32(indices.size()), encodedIndices);
+
+        MeshFileCompressed sizes;
+        sizes.vertexBytes = UInt32(encodedVertices.size());
+        sizes.indexBytes = UInt32(encodedIndices.size());
+        std::fwrite(&sizes, sizeof(sizes), 1, out);
+        std::fwrite(&encodedVertices[0], 1, encodedVertices.size(), out);
+        if(!encodedIndices.empty()) std::fwrite(&encodedIndices[0], 1, encodedIndices.size(), out);
+    } else {
+        std::fwrite(&vertices[0], sizeof(MeshVertex), vertices.size(), out);
+        for(auto it = indices.begin(); it != indices.end(); ++it) {
+            if(header.indexSize == 2) {
+                UInt16 index = UInt16(*it);
+                std::fwrite(&index, sizeof(index), 1, out);
+            } else {
+                std::fwrite(&*it, sizeof(*it), 1, out);
+            }
+        }
+    }
+
+    bool ok = std::ferror(out) == 0;
+    ok = std::fclose(out) == 0 && ok;
+    if(!ok) {
+        std::fprintf(stderr, "build_mesh: failed writing %s\n", outputName);
+        return 1;
+    }
+    return 0;
+}
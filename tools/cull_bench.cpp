@@ -0,0 +1,96 @@
+//
+// Times RenderCullSet::Cull over a large random world with a camera turning a little every frame
+//
+// usage: cull_bench [-n objects] [-f frames]
+//
+// bin/cull_bench uses the SSE or NEON path render_cull.cpp picks for the target, bin/cull_bench_scalar
+// is the same program built with RENDER_CULL_SCALAR. Both generate the same world and cameras, so the
+// visible totals they print have to match.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../polymania/types.hpp"
+#include "../polymania/render_cull.hpp"
+
+static const float WORLD_SIZE = 1000.0f;
+
+static UInt32 NextRandom(UInt32 &ioSeed) {
+    ioSeed = ioSeed*1103515245 + 12345;
+    return ioSeed >> 8;
+}
+
+static float RandomFloat(UInt32 &ioSeed, float inMin, float inMax) {
+    return inMin + (inMax - inMin)*float(NextRandom(ioSeed) & 0xFFFF)/65535.0f;
+}
+
+int main(int argc, char **argv) {
+    UInt32 numObjects = 1000000;
+    UInt32 numFrames = 100;
+    int arg = 1;
+    for(; arg < argc; ++arg) {
+        if(std::strcmp(argv[arg], "-n") == 0 && arg+1 < argc) {
+            numObjects = UInt32(std::atoi(argv[++arg]));
+        } else if(std::strcmp(argv[arg], "-f") == 0 && arg+1 < argc) {
+            numFrames = UInt32(std::atoi(argv[++arg]));
+        } else {
+            break;
+        }
+    }
+    if(arg != argc || !numObjects || !numFrames) {
+        std::fprintf(stderr, "usage: %s [-n objects] [-f frames]\n", argv[0]);
+        return 1;
+    }
+
+    // mostly boxes of a few units, every fourth object a sphere
+    RenderCullSet objects;
+    UInt32 seed = 1;
+    for(UInt32 i = 0; i < numObjects; ++i) {
+        glm::vec3 center(RandomFloat(seed, -WORLD_SIZE, WORLD_SIZE), RandomFloat(seed, -WORLD_SIZE*0.1f, WORLD_SIZE*0.1f), RandomFloat(seed, -WORLD_SIZE, WORLD_SIZE));
+        if(i % 4 == 3) {
+            objects.AddSphere(center, RandomFloat(seed, 0.5f, 4.0f));
+        } else {
+            glm::vec3 extent(RandomFloat(seed, 0.25f, 2.5f), RandomFloat(seed, 0.25f, 2.5f), RandomFloat(seed, 0.25f, 2.5f));
+            objects.AddBox(center - extent, center + extent);
+        }
+    }
+
+    glm::mat4 projection = glm::perspective(60.0f, 16.0f/9.0f, 0.1f, WORLD_SIZE*0.5f);
+    std::vector<UInt32> visible;
+    visible.reserve(numObjects);
+    UInt64 totalVisible = 0;
+    double totalSeconds = 0.0, bestSeconds = 0.0;
+    for(UInt32 frame = 0; frame < numFrames; ++frame) {
+        float angle = 6.2831853f*float(frame)/float(numFrames);
+        glm::vec3 eye(0.0f, 20.0f, 0.0f);
+        glm::mat4 view = glm::lookAt(eye, eye + glm::vec3(std::cos(angle), -0.1f, std::sin(angle)), glm::vec3(0.0f, 1.0f, 0.0f));
+        RenderFrustum frustum(projection*view);
+
+        visible.clear();
+        auto start = std::chrono::high_resolution_clock::now();
+        objects.Cull(frustum, visible);
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        totalSeconds += seconds;
+        bestSeconds = frame ? std::min(bestSeconds, seconds) : seconds;
+        totalVisible += visible.size();
+    }
+
+#if defined(RENDER_CULL_SCALAR)
+    const char *path = "scalar";
+#else
+    const char *path = "simd";
+#endif
+    std::printf("cull_bench (%s): %u objects, %u frames, %.3f ms average, %.3f ms best, %llu visible in total\n", path, unsigned(numObjects), unsigned(numFrames),
+                totalSeconds*1000.0/numFrames, bestSeconds*1000.0, (unsigned long long)totalVisible);
+    return 0;
+}
@@ -0,0 +1,121 @@
+//
+// Converts resource files into a C++ source file for ResourceDirectoryEmbedded
+//
+// usage: embed_resources <output.cpp> <resource root> <location>...
+//
+// Locations are relative to the resource root and become the names the files are opened by,
+// the index is sorted by location so the directory can binary search it.
+// The output belongs in polymania/generated/, it includes the engine headers from its parent directory.
+//
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+struct EmbeddedFile {
+    std::string location;
+    std::vector<unsigned char> data;
+};
+
+static bool CompareLocation(const EmbeddedFile &a, const EmbeddedFile &b) {
+    return a.location < b.location;
+}
+
+static bool ReadFile(const std::string &inPath, std::vector<unsigned char> &outData) {
+    std::FILE *fp = std::fopen(inPath.c_str(), "rb");
+    if(!fp) return false;
+
+    unsigned char buf[64*1024];
+    size_t bytesRead;
+    while((bytesRead = std::fread(buf, 1, sizeof(buf), fp)) > 0) {
+        outData.insert(outData.end(), buf, buf + bytesRead);
+    }
+    bool ok = std::ferror(fp) == 0;
+    std::fclose(fp);
+    return ok;
+}
+
+static void WriteString(std::FILE *fp, const std::string &inString) {
+    std::fputc('"', fp);
+    for(auto it = inString.begin(); it != inString.end(); ++it) {
+        if(*it == '"' || *it == '\\') std::fputc('\\', fp);
+        std::fputc(*it, fp);
+    }
+    std::fputc('"', fp);
+}
+
+int main(int argc, char **argv) {
+    if(argc < 3) {
+        std::fprintf(stderr, "usage: %s <output.cpp> <resource root> <location>...\n", argv[0]);
+        return 1;
+    }
+
+    std::string root = argv[2];
+    std::vector<EmbeddedFile> files;
+    for(int i = 3; i < argc; ++i) {
+        EmbeddedFile file;
+        file.location = argv[i];
+        std::replace(file.location.begin(), file.location.end(), '\\', '/');
+        if(!ReadFile(root + "/" + file.location, file.data)) {
+            std::fprintf(stderr, "embed_resources: could not read %s/%s\n", root.c_str(), file.location.c_str());
+            return 1;
+        }
+        files.push_back(file);
+    }
+    std::sort(files.begin(), files.end(), &CompareLocation);
+    for(size_t i = 1; i < files.size(); ++i) {
+        if(files[i].location == files[i-1].location) {
+            std::fprintf(stderr, "embed_resources: %s listed twice\n", files[i].location.c_str());
+            return 1;
+        }
+    }
+
+    std::FILE *out = std::fopen(argv[1], "wb");
+    if(!out) {
+        std::fprintf(stderr, "embed_resources: could not write %s\n", argv[1]);
+        return 1;
+    }
+
+    std::fprintf(out, 
+        "// generated by tools/embed_resources, do not edit\n\n"
+        "#include <memory>\n"
+        "#include <unordered_map>\n"
+        "#include <list>\n"
+        "#include <vector>\n"
+        "#include <string>\n"
+        "#include <atomic>\n"
+        "#include <mutex>\n\n"
+        "#include \"../types.hpp\"\n"
+        "#include \"../asyncmodel.hpp\"\n"
+        "#include \"../resource.hpp\"\n"
+        "#include \"../resource_embedded.hpp\"\n\n");
+
+    for(size_t i = 0; i < files.size(); ++i) {
+        const std::vector<unsigned char> &data = files[i].data;
+        std::fprintf(out, "// %s\n", files[i].location.c_str());
+        std::fprintf(out, "RESOURCE_EMBEDDED_ALIGN static const UInt8 RESOURCE_%u[%u] = {", unsigned(i), unsigned(data.size() + 1));
+        for(size_t j = 0; j < data.size(); ++j) {
+            std::fprintf(out, "%s%u,", j % 24 == 0 ? "\n    " : "", unsigned(data[j]));
+        }
+        std::fprintf(out, "%s0\n};\n\n", data.size() % 24 == 0 ? "\n    " : "");
+    }
+
+    std::fprintf(out, "const ResourceEmbeddedEntry ResourceEmbeddedIndex[] = {\n");
+    for(size_t i = 0; i < files.size(); ++i) {
+        std::fprintf(out, "    {");
+        WriteString(out, files[i].location);
+        std::fprintf(out, ", RESOURCE_%u, %u},\n", unsigned(i), unsigned(files[i].data.size()));
+    }
+    // keeps the array valid when nothing is embedded
+    std::fprintf(out, "    {0, 0, 0}\n};\n\n");
+    std::fprintf(out, "const UInt32 ResourceEmbeddedCount = %u;\n", unsigned(files.size()));
+
+    bool ok = std::ferror(out) == 0;
+    ok = std::fclose(out) == 0 && ok;
+    if(!ok) {
+        std::fprintf(stderr, "embed_resources: failed writing %s\n", argv[1]);
+        return 1;
+    }
+    return 0;
+}
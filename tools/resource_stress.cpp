@@ -0,0 +1,312 @@
+//
+// Hammers ResourceManager and ResourceCache from many threads and checks the books balance afterwards
+//
+// usage: resource_stress [-t threads] [-n iterations] [-l locations]
+//
+// The manager pass has every thread Load by location and by ResourceId, Request in the background and
+// Trim against a budget that keeps evicting, while the main thread finalizes requests. The cache pass
+// has the threads Load, LoadResident and Trim while the main thread Refreshes and Reloads what they
+// hold, reloading stays main thread only as documented. Resources fill their payload with a pattern
+// of their location so a handle to the wrong or a freed resource shows up.
+//
+// At the end no resource may be linked, cache memory has to match what the live resources allocated
+// and once everything is destroyed the tracking allocator has to be back at 0 bytes.
+// Returns 0 if every check passed.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <list>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "../polymania/types.hpp"
+#include "../polymania/asyncmodel.hpp"
+#include "../polymania/resource.hpp"
+#include "../polymania/resource_tracking.hpp"
+
+static const UInt32 HELD_HANDLES = 8; // per thread, so some resources stay linked while others are evicted
+
+static std::atomic<Int32> liveResources(0);
+static std::atomic<UInt> livePayloadBytes(0);
+static std::atomic<UInt32> failures(0);
+
+static void Fail(const char *inWhat, const std::string &inLocation) {
+    if(failures++ < 20) std::fprintf(stderr, "resource_stress: %s (%s)\n", inWhat, inLocation.c_str());
+}
+
+class StressResource : public Resource {
+public:
+    StressResource() : payload(0), payloadSize(0), allocator(0) {}
+
+    bool Load(ResourceMemoryAllocator &inAllocator, ResourceDirectory &inDir) {
+        // sizes differ per location so the memory totals are not a simple multiple
+        UInt64 hash = ResourceId::Hash(GetLocation());
+        UInt size = 16 + UInt(hash % 1024);
+        payload = (UInt8*)inAllocator.Allocate(size);
+        if(!payload) return false;
+        std::memset(payload, GetPattern(), size);
+        payloadSize = size;
+        allocator = &inAllocator;
+        liveResources++;
+        livePayloadBytes += payloadSize;
+        return true;
+    }
+    bool Unload() {
+        if(!payload) return false;
+        std::memset(payload, ~GetPattern(), payloadSize);
+        allocator->Free(payload);
+        liveResources--;
+        livePayloadBytes -= payloadSize;
+        payload = 0;
+        payloadSize = 0;
+        return true;
+    }
+    UInt GetSizeBytes() const { return payloadSize; }
+
+    bool IsIntact() const {
+        if(!payload) return false;
+        for(UInt i = 0; i < payloadSize; ++i) {
+            if(payload[i] != GetPattern()) return false;
+        }
+        return true;
+    }
+
+private:
+    UInt8 GetPattern() const { return UInt8(ResourceId::Hash(GetLocation()) >> 8) | 1; }
+
+private:
+    UInt8 *payload;
+    UInt payloadSize;
+    ResourceMemoryAllocator *allocator;
+};
+
+static void ConstructStressResource(Resource *outResource) {
+    new(outResource)StressResource();
+}
+
+static UInt32 NextRandom(UInt32 &ioSeed) {
+    ioSeed = ioSeed*1103515245 + 12345;
+    return ioSeed >> 8;
+}
+
+static std::string MakeLocation(UInt32 inIndex) {
+    char buffer[32];
+    std::sprintf(buffer, "stress/%u.str", unsigned(inIndex));
+    return buffer;
+}
+
+static void CheckHandle(const ResourceHandle &inHandle, const std::string &inLocation, bool inCheckPayload) {
+    if(!inHandle) {
+        Fail("load returned null", inLocation);
+    } else if(inHandle->GetLocation() != inLocation) {
+        Fail("handle to the wrong location", inLocation);
+    } else if(inCheckPayload && !static_cast<StressResource*>(inHandle.get())->IsIntact()) {
+        Fail("payload overwritten", inLocation);
+    }
+}
+
+struct ManagerPass {
+    ResourceManager manager;
+    std::vector<std::string> locations;
+    std::vector<ResourceId> ids;
+    std::mutex requestsMutex;
+    std::vector<ResourceRequest> requests;
+
+    void Worker(UInt32 inSeed, UInt32 inIterations) {
+        std::vector<ResourceHandle> held(HELD_HANDLES);
+        for(UInt32 i = 0; i < inIterations; ++i) {
+            UInt32 k = NextRandom(inSeed) % UInt32(locations.size());
+            ResourceHandle handle = (i & 1) ? manager.Load(ids[k]) : manager.Load(locations[k]);
+            CheckHandle(handle, locations[k], true);
+            held[NextRandom(inSeed) % HELD_HANDLES] = handle;
+
+            if(i % 64 == 0) manager.Trim();
+            if(i % 97 == 0) {
+                // resolving ids races with the Loads above
+                if(!manager.MakeId(locations[k]).IsValid()) Fail("MakeId failed", locations[k]);
+                std::lock_guard<std::mutex> lock(requestsMutex);
+                requests.push_back(manager.Request(locations[NextRandom(inSeed) % UInt32(locations.size())], Int32(i % 4)));
+            }
+        }
+    }
+};
+
+struct CachePass {
+    CachePass() : cache("str", sizeof(StressResource), &ConstructStressResource), running(true) {}
+
+    ResourceCache cache;
+    std::vector<std::string> locations;
+    UInt budget;
+    std::atomic<bool> running;
+
+    void Worker(UInt32 inSeed) {
+        std::vector<ResourceHandle> held(HELD_HANDLES);
+        for(UInt32 i = 0; running; ++i) {
+            UInt32 k = NextRandom(inSeed) % UInt32(locations.size());
+            ResourceHandle handle;
+            switch(i % 3) {
+                case 0:
+                    handle = cache.LoadResident(ResourceId::Hash(locations[k]));
+                    if(!handle) handle = cache.Load(locations[k]);
+                    break;
+                case 1:
+                    handle = cache.LoadResident(locations[k]);
+                    if(!handle) handle = cache.Load(locations[k]);
+                    break;
+                default:
+                    handle = cache.Load(locations[k]);
+                    break;
+            }
+            // the main thread may be reloading the payload right now, only the main thread looks at it
+            CheckHandle(handle, locations[k], false);
+            held[NextRandom(inSeed) % HELD_HANDLES] = handle;
+
+            if(i % 64 == 0) cache.Trim(budget, ~UInt32(0));
+            if(i % 251 == 0) cache.EvictOldest();
+        }
+    }
+};
+
+static void CheckMemory(const char *inPass, UInt inUsage, UInt32 inNumLinked) {
+    UInt expected = UInt(liveResources)*sizeof(StressResource) + livePayloadBytes;
+    std::printf("%s: %d resident, %u bytes charged, %u expected, %u linked\n", inPass, Int32(liveResources), unsigned(inUsage), unsigned(expected), unsigned(inNumLinked));
+    if(inUsage != expected) Fail("memory usage does not match the live resources", inPass);
+    if(inNumLinked) Fail("resources still linked with every handle dropped", inPass);
+}
+
+static void RunManagerPass(UInt32 inThreads, UInt32 inIterations, UInt32 inLocations) {
+    ManagerPass pass;
+    pass.manager.AddResourceLoader("str", sizeof(StressResource), &ConstructStressResource);
+    pass.manager.SetStreamingThreads(2);
+    for(UInt32 i = 0; i < inLocations; ++i) {
+        pass.locations.push_back(MakeLocation(i));
+        pass.ids.push_back(pass.manager.MakeId(pass.locations.back()));
+    }
+    // about a quarter of everything fits, Trim evicts all the time
+    UInt budget = inLocations*(sizeof(StressResource) + 16 + 512)/4;
+    pass.manager.SetMemoryBudget(budget);
+
+    std::vector<std::thread> threads;
+    for(UInt32 t = 0; t < inThreads; ++t) {
+        threads.push_back(std::thread(&ManagerPass::Worker, &pass, t*7919 + 1, inIterations));
+    }
+    // requests are finalized on the main thread while the workers keep going
+    bool done = false;
+    while(!done) {
+        pass.manager.Update(0.001, ~UInt(0));
+        std::lock_guard<std::mutex> lock(pass.requestsMutex);
+        done = pass.requests.size() >= (inIterations + 96)/97*inThreads;
+    }
+    for(auto it = threads.begin(); it != threads.end(); ++it) {
+        it->join();
+    }
+
+    for(bool pending = true; pending;) {
+        pass.manager.Update(0.001, ~UInt(0));
+        pending = false;
+        for(auto it = pass.requests.begin(); it != pass.requests.end(); ++it) {
+            if(!it->IsComplete()) pending = true;
+        }
+        std::this_thread::yield();
+    }
+    for(auto it = pass.requests.begin(); it != pass.requests.end(); ++it) {
+        if(it->GetStatus() != ResourceRequest::STATUS_Complete) Fail("request failed", it->GetLocation());
+        else CheckHandle(it->GetResource(), it->GetLocation(), true);
+    }
+    pass.requests.clear();
+
+    CheckMemory("manager", pass.manager.GetMemoryUsage(), 0);
+    pass.manager.PrintStats();
+    // with every handle dropped nothing is linked, a reference left behind keeps its resource from being trimmed
+    pass.manager.SetMemoryBudget(1);
+    pass.manager.Trim();
+    if(pass.manager.GetMemoryUsage()) Fail("resources still linked with every handle dropped", "manager");
+}
+
+static void RunCachePass(UInt32 inThreads, UInt32 inIterations, UInt32 inLocations) {
+    CachePass pass;
+    for(UInt32 i = 0; i < inLocations; ++i) {
+        pass.locations.push_back(MakeLocation(i));
+    }
+    pass.budget = inLocations*(sizeof(StressResource) + 16 + 512)/4;
+
+    std::vector<std::thread> threads;
+    for(UInt32 t = 0; t < inThreads; ++t) {
+        threads.push_back(std::thread(&CachePass::Worker, &pass, t*104729 + 3));
+    }
+    UInt32 seed = 12345;
+    for(UInt32 i = 0; i < inIterations; ++i) {
+        const std::string &location = pass.locations[NextRandom(seed) % inLocations];
+        ResourceHandle handle;
+        if(i & 1) {
+            // linked ones are reloaded in place, unlinked ones dropped
+            if(pass.cache.Refresh(location, handle) && handle) CheckHandle(handle, location, true);
+        } else {
+            handle = pass.cache.LoadResident(location);
+            if(handle) {
+                if(!pass.cache.Reload(handle)) Fail("reload failed", location);
+                CheckHandle(handle, location, true);
+            }
+        }
+    }
+    pass.running = false;
+    for(auto it = threads.begin(); it != threads.end(); ++it) {
+        it->join();
+    }
+
+    ResourceCacheStats stats = pass.cache.GetStats();
+    CheckMemory("cache", stats.memoryUsage, stats.numLinked);
+    std::printf("cache: %llu hits, %llu misses, %llu evictions\n", (unsigned long long)stats.hits, (unsigned long long)stats.misses, (unsigned long long)stats.evictions);
+    pass.cache.Purge();
+    stats = pass.cache.GetStats();
+    if(stats.numUnlinked || stats.memoryUsage) Fail("Purge left resources behind", "cache");
+}
+
+int main(int argc, char **argv) {
+    UInt32 numThreads = std::max(2u, std::thread::hardware_concurrency());
+    UInt32 numIterations = 100000;
+    UInt32 numLocations = 512;
+    for(int arg = 1; arg < argc; ++arg) {
+        if(std::strcmp(argv[arg], "-t") == 0 && arg+1 < argc) {
+            numThreads = UInt32(std::atoi(argv[++arg]));
+        } else if(std::strcmp(argv[arg], "-n") == 0 && arg+1 < argc) {
+            numIterations = UInt32(std::atoi(argv[++arg]));
+        } else if(std::strcmp(argv[arg], "-l") == 0 && arg+1 < argc) {
+            numLocations = UInt32(std::atoi(argv[++arg]));
+        } else {
+            numThreads = 0;
+            break;
+        }
+    }
+    if(!numThreads || !numIterations || !numLocations) {
+        std::fprintf(stderr, "usage: %s [-t threads] [-n iterations] [-l locations]\n", argv[0]);
+        return 1;
+    }
+    std::printf("resource_stress: %u threads, %u iterations, %u locations\n", unsigned(numThreads), unsigned(numIterations), unsigned(numLocations));
+
+    // every byte either pass allocates goes through here
+    ResourceMemoryAllocator *backing = ResourceMemoryAllocator::instance;
+    ResourceMemoryAllocatorTracking tracker(backing);
+    ResourceMemoryAllocator::instance = &tracker;
+
+    RunManagerPass(numThreads, numIterations, numLocations);
+    RunCachePass(numThreads, numIterations, numLocations);
+
+    if(liveResources || livePayloadBytes) Fail("resources left loaded after destruction", "all");
+    ResourceMemorySnapshot snapshot;
+    tracker.GetSnapshot(snapshot);
+    std::printf("allocator: %u bytes in %u allocations left, %u allocations made\n", unsigned(snapshot.currentBytes), unsigned(snapshot.numAllocations), unsigned(snapshot.totalAllocations));
+    if(snapshot.currentBytes || snapshot.numAllocations) Fail("allocations outlived the caches", "all");
+    ResourceMemoryAllocator::instance = backing;
+
+    std::printf("%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}